@@ -0,0 +1,109 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Arm dead time benchmark on a real detector.
+ *
+ * A scan of nb_points single internal trigger acquisitions of one frame
+ * is run twice: first arming the detector for every point, then with the
+ * series armed once for all points (Camera::setNbTriggersPerArm) and
+ * re-triggered. The prepareAcq time and the whole point time are reported,
+ * with the dead time saved per scan point.
+ *
+ * usage: EigerArmBench detector_ip [nb_points] [exp_time]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "EigerCamera.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+static double _now()
+{
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+struct ScanTimes
+{
+  double prepare;
+  double point;
+};
+
+static ScanTimes _scan(Camera& cam,int nb_points,int nb_triggers_per_arm)
+{
+  cam.setNbTriggersPerArm(nb_triggers_per_arm);
+  ScanTimes times = {0.,0.};
+  for(int i = 0;i < nb_points;++i)
+    {
+      double start = _now();
+      cam.prepareAcq();
+      double prepared = _now();
+      cam.startAcq();
+      while(cam.getStatus() != Camera::Ready)
+	usleep(100);
+      double end = _now();
+      times.prepare += prepared - start;
+      times.point += end - start;
+    }
+  times.prepare /= nb_points;
+  times.point /= nb_points;
+  return times;
+}
+
+int main(int argc,char* argv[])
+{
+  int nb_points = argc > 2 ? atoi(argv[2]) : 20;
+  double exp_time = argc > 3 ? atof(argv[3]) : 0.001;
+  if(argc < 2 || nb_points < 1 || exp_time <= 0.)
+    {
+      fprintf(stderr,"usage: %s detector_ip [nb_points] [exp_time]\n",argv[0]);
+      return 1;
+    }
+
+  try
+    {
+      Camera cam(argv[1]);
+      cam.setTrigMode(IntTrig);
+      cam.setExpTime(exp_time);
+      cam.setNbFrames(1);
+      printf("%d scan points, exposure time %g s\n",nb_points,exp_time);
+
+      ScanTimes arm = _scan(cam,nb_points,1);
+      printf("arm every point:  prepareAcq %8.2f ms, point %8.2f ms\n",
+	     arm.prepare * 1e3,arm.point * 1e3);
+      ScanTimes reuse = _scan(cam,nb_points,nb_points);
+      printf("arm once:         prepareAcq %8.2f ms, point %8.2f ms\n",
+	     reuse.prepare * 1e3,reuse.point * 1e3);
+      printf("saved dead time per scan point: %8.2f ms\n",
+	     (arm.point - reuse.point) * 1e3);
+    }
+  catch(Exception& e)
+    {
+      fprintf(stderr,"%s\n",e.getErrMsg().c_str());
+      return 1;
+    }
+  return 0;
+}
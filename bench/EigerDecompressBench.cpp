@@ -0,0 +1,284 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Decompression micro-benchmark on synthetic Eiger frames.
+ *
+ * Frames are generated with Poisson counts, module gaps (all-ones pixels)
+ * and a few masked pixels, for the 1M, 4M, 9M and 16M geometries in 16 and
+ * 32 bits. Each kernel is run by 1 to N threads, every thread decompressing
+ * its own frames, and the aggregated throughput is reported.
+ *
+ * usage: EigerDecompressBench [nb_frames_per_thread] [max_nb_threads] [mean_count]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <vector>
+#include <random>
+#include <string>
+
+#include "lz4.h"
+#ifdef WITH_BITSHUFFLE
+#include "bitshuffle.h"
+#endif
+
+#include "EigerDecompress.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+static const int MODULE_WIDTH = 1030;
+static const int MODULE_HEIGHT = 514;
+static const int MODULE_X_GAP = 10;
+static const int MODULE_Y_GAP = 37;
+
+struct Geometry
+{
+  const char*	name;
+  int		nb_module_x;
+  int		nb_module_y;
+
+  int width() const {return nb_module_x * MODULE_WIDTH + (nb_module_x - 1) * MODULE_X_GAP;}
+  int height() const {return nb_module_y * MODULE_HEIGHT + (nb_module_y - 1) * MODULE_Y_GAP;}
+};
+
+static const Geometry GEOMETRIES[] = {{"1M",1,2},{"4M",2,4},{"9M",3,6},{"16M",4,8}};
+
+/** synthetic frame, gaps are saturated (all-ones) as sent by the detector
+ */
+template<class T>
+static void _generate_frame(const Geometry& geometry,double mean_count,
+			    unsigned int seed,std::vector<T>& frame)
+{
+  int width = geometry.width(),height = geometry.height();
+  frame.resize(width * height);
+  std::mt19937 generator(seed);
+  std::poisson_distribution<int> poisson(mean_count);
+  for(int y = 0;y < height;++y)
+    {
+      bool y_gap = y % (MODULE_HEIGHT + MODULE_Y_GAP) >= MODULE_HEIGHT;
+      for(int x = 0;x < width;++x)
+	{
+	  bool x_gap = x % (MODULE_WIDTH + MODULE_X_GAP) >= MODULE_WIDTH;
+	  frame[y * width + x] = (x_gap || y_gap) ? T(-1) : T(poisson(generator));
+	}
+    }
+}
+
+/** mask every gap pixel and 0.1% of random pixels
+ */
+template<class T>
+static void _generate_mask(const std::vector<T>& frame,Decompress::PixelMask& pixel_mask)
+{
+  std::vector<uint8_t> mask(frame.size());
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> uniform(0,999);
+  for(size_t i = 0;i < frame.size();++i)
+    mask[i] = frame[i] == T(-1) || !uniform(generator);
+  pixel_mask.build(mask.data(),mask.size());
+}
+
+enum Kernel {LZ4,LZ4_WIDEN,FULL,BSLZ4};
+// full is the reconstruction task path: lz4, widening (16 bits), mask and statistics
+static const char* KERNEL_NAMES[] = {"lz4","lz4+widen","full","bslz4"};
+
+struct Job
+{
+  Kernel				kernel;
+  const std::vector<char>*		compressed;
+  int					msg_depth;
+  int					frame_size;
+  const Decompress::PixelMask*		pixel_mask;
+  int					nb_frames;
+  pthread_barrier_t*			barrier;
+  int					error;
+};
+
+static double _now()
+{
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void* _run_job(void* arg)
+{
+  Job& job = *(Job*)arg;
+  int nb_pixels = job.frame_size / job.msg_depth;
+  int dst_depth = job.kernel == LZ4 || job.kernel == BSLZ4 ? job.msg_depth : 4;
+  void* dst;
+  if(posix_memalign(&dst,16,nb_pixels * dst_depth))
+    {
+      job.error = -1;
+      return NULL;
+    }
+  memset(dst,0,nb_pixels * dst_depth);
+
+  pthread_barrier_wait(job.barrier);
+  for(int i = 0;i < job.nb_frames && !job.error;++i)
+    {
+      int return_code;
+      Camera::FrameStatistics statistics;
+      void* msg_data = (void*)job.compressed->data();
+      size_t msg_size = job.compressed->size();
+      switch(job.kernel)
+	{
+	case LZ4:
+	case LZ4_WIDEN:
+	  return_code = Decompress::decompressFrame(msg_data,msg_size,job.msg_depth,
+						    dst,nb_pixels * dst_depth,dst_depth);
+	  break;
+	case FULL:
+	  return_code = Decompress::decompressFrame(msg_data,msg_size,job.msg_depth,
+						    dst,nb_pixels * dst_depth,dst_depth,
+						    job.pixel_mask,&statistics);
+	  break;
+#ifdef WITH_BITSHUFFLE
+	case BSLZ4:
+	  return_code = bshuf_decompress_lz4(msg_data,dst,nb_pixels,job.msg_depth,0);
+	  break;
+#endif
+	default:
+	  return_code = -1;
+	  break;
+	}
+      if(return_code < 0)
+	job.error = return_code;
+    }
+  pthread_barrier_wait(job.barrier);
+  free(dst);
+  return NULL;
+}
+
+/** @return the elapsed time for nb_threads threads decompressing
+ *  nb_frames frames each, or a negative value on error
+ */
+static double _run(Kernel kernel,const std::vector<char>& compressed,int msg_depth,
+		   int frame_size,const Decompress::PixelMask& pixel_mask,
+		   int nb_frames,int nb_threads)
+{
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier,NULL,nb_threads + 1);
+  std::vector<Job> jobs(nb_threads);
+  std::vector<pthread_t> threads(nb_threads);
+  for(int i = 0;i < nb_threads;++i)
+    {
+      Job job = {kernel,&compressed,msg_depth,frame_size,&pixel_mask,
+		 nb_frames,&barrier,0};
+      jobs[i] = job;
+      pthread_create(&threads[i],NULL,_run_job,&jobs[i]);
+    }
+  pthread_barrier_wait(&barrier);
+  double start = _now();
+  pthread_barrier_wait(&barrier);
+  double elapsed = _now() - start;
+  int error = 0;
+  for(int i = 0;i < nb_threads;++i)
+    {
+      pthread_join(threads[i],NULL);
+      if(jobs[i].error) error = jobs[i].error;
+    }
+  pthread_barrier_destroy(&barrier);
+  return error ? -1. : elapsed;
+}
+
+template<class T>
+static void _bench(const Geometry& geometry,double mean_count,
+		   int nb_frames,int max_nb_threads)
+{
+  std::vector<T> frame;
+  _generate_frame(geometry,mean_count,1234,frame);
+  Decompress::PixelMask pixel_mask;
+  _generate_mask(frame,pixel_mask);
+  int frame_size = frame.size() * sizeof(T);
+
+  std::vector<char> lz4(LZ4_compressBound(frame_size));
+  lz4.resize(LZ4_compress_default((const char*)frame.data(),lz4.data(),
+				  frame_size,lz4.size()));
+#ifdef WITH_BITSHUFFLE
+  std::vector<char> bslz4(bshuf_compress_lz4_bound(frame.size(),sizeof(T),0));
+  bslz4.resize(bshuf_compress_lz4(frame.data(),bslz4.data(),frame.size(),sizeof(T),0));
+#endif
+
+  for(int kernel = LZ4;kernel <= BSLZ4;++kernel)
+    {
+      const std::vector<char>* compressed = &lz4;
+      if(kernel == BSLZ4)
+	{
+#ifdef WITH_BITSHUFFLE
+	  compressed = &bslz4;
+#else
+	  continue;
+#endif
+	}
+      // widening is only done for 16 bits frames
+      if(kernel == LZ4_WIDEN && sizeof(T) != 2)
+	continue;
+
+      for(int nb_threads = 1;nb_threads <= max_nb_threads;nb_threads *= 2)
+	{
+	  double elapsed = _run(Kernel(kernel),*compressed,sizeof(T),frame_size,
+				pixel_mask,nb_frames,nb_threads);
+	  if(elapsed < 0.)
+	    {
+	      printf("%-4s %2d bits %-20s %3d threads: decompression error\n",
+		     geometry.name,int(sizeof(T) * 8),KERNEL_NAMES[kernel],nb_threads);
+	      continue;
+	    }
+	  double total_frames = double(nb_frames) * nb_threads;
+	  printf("%-4s %2d bits %-20s %3d threads: ratio %5.2f %8.2f GB/s %10.1f frames/s\n",
+		 geometry.name,int(sizeof(T) * 8),KERNEL_NAMES[kernel],nb_threads,
+		 double(frame_size) / compressed->size(),
+		 total_frames * frame_size / elapsed / 1e9,
+		 total_frames / elapsed);
+	}
+    }
+}
+
+int main(int argc,char* argv[])
+{
+  int nb_frames = argc > 1 ? atoi(argv[1]) : 20;
+  int max_nb_threads = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+  double mean_count = argc > 3 ? atof(argv[3]) : 0.1;
+  if(nb_frames < 1 || max_nb_threads < 1 || mean_count < 0.)
+    {
+      fprintf(stderr,"usage: %s [nb_frames_per_thread] [max_nb_threads] [mean_count]\n",
+	      argv[0]);
+      return 1;
+    }
+  printf("%d frames per thread, up to %d threads, mean count %g\n",
+	 nb_frames,max_nb_threads,mean_count);
+#ifndef WITH_BITSHUFFLE
+  printf("bslz4 not benchmarked (build with BITSHUFFLE=1)\n");
+#endif
+
+  for(size_t i = 0;i < sizeof(GEOMETRIES) / sizeof(Geometry);++i)
+    {
+      _bench<uint16_t>(GEOMETRIES[i],mean_count,nb_frames,max_nb_threads);
+      _bench<uint32_t>(GEOMETRIES[i],mean_count,nb_frames,max_nb_threads);
+    }
+  return 0;
+}
@@ -0,0 +1,242 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+/* Checks of the decompression kernels on small synthetic frames:
+ * pixel masking, saturated pixel remapping, 16 bits narrowing,
+ * software summation, roi extraction, sparse frames and truncated
+ * lz4 messages.
+ *
+ * usage: EigerDecompressCheck
+ * returns the number of failed checks.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "lz4.h"
+
+#include "EigerDecompress.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+static const int WIDTH = 16;
+static const int HEIGHT = 8;
+static const int NB_PIXELS = WIDTH * HEIGHT;
+
+static int nb_failed = 0;
+
+#define CHECK(condition)						\
+  if(!(condition))							\
+    {									\
+      printf("%s:%d: %s failed\n",__FILE__,__LINE__,#condition);	\
+      ++nb_failed;							\
+    }
+
+/** frame with a saturated (all-ones) pixel, a zero line and counts
+ */
+template<class T>
+static std::vector<T> _frame(T saturated = T(-1))
+{
+  std::vector<T> frame(NB_PIXELS);
+  for(int i = 0;i < NB_PIXELS;++i)
+    frame[i] = T(i % WIDTH == 3 ? 0 : i);
+  frame[5] = saturated;
+  return frame;
+}
+
+template<class T>
+static std::vector<char> _compress(const std::vector<T>& frame)
+{
+  int size = frame.size() * sizeof(T);
+  std::vector<char> compressed(LZ4_compressBound(size));
+  compressed.resize(LZ4_compress_default((const char*)frame.data(),compressed.data(),
+					 size,compressed.size()));
+  return compressed;
+}
+
+static void _check_mask()
+{
+  std::vector<uint16_t> frame = _frame<uint16_t>();
+  std::vector<char> compressed = _compress(frame);
+  std::vector<uint8_t> mask(NB_PIXELS,0);
+  mask[0] = mask[1] = mask[40] = mask[NB_PIXELS - 1] = 1;
+  Decompress::PixelMask pixel_mask;
+  pixel_mask.build(mask.data(),NB_PIXELS);
+  CHECK(pixel_mask.m_runs.size() == 3);
+  CHECK(pixel_mask.getNbMaskedPixels() == 4);
+
+  // widened to 32 bits
+  std::vector<uint32_t> dst(NB_PIXELS,0xdead);
+  Camera::FrameStatistics statistics;
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),2,
+				    dst.data(),NB_PIXELS * 4,4,
+				    &pixel_mask,&statistics) >= 0);
+  for(int i = 0;i < NB_PIXELS;++i)
+    {
+      uint32_t expected = mask[i] ? 0 : (frame[i] == 0xffff ? 0xffffffff : frame[i]);
+      CHECK(dst[i] == expected);
+    }
+  CHECK(statistics.nb_saturated == 1);
+
+  // same depth
+  std::vector<uint16_t> dst16(NB_PIXELS,0xdead);
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),2,
+				    dst16.data(),NB_PIXELS * 2,2,&pixel_mask) >= 0);
+  for(int i = 0;i < NB_PIXELS;++i)
+    CHECK(dst16[i] == (mask[i] ? 0 : frame[i]));
+}
+
+static void _check_saturated()
+{
+  const unsigned int saturated_value = 100000;
+  // 16 bits widened to 32 bits
+  std::vector<uint16_t> frame16 = _frame<uint16_t>();
+  std::vector<char> compressed = _compress(frame16);
+  std::vector<uint32_t> dst(NB_PIXELS);
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),2,
+				    dst.data(),NB_PIXELS * 4,4,
+				    NULL,NULL,saturated_value) >= 0);
+  CHECK(dst[5] == saturated_value);
+  CHECK(dst[6] == 6);
+
+  // native 32 bits
+  std::vector<uint32_t> frame32 = _frame<uint32_t>();
+  compressed = _compress(frame32);
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),4,
+				    dst.data(),NB_PIXELS * 4,4,
+				    NULL,NULL,saturated_value) >= 0);
+  CHECK(dst[5] == saturated_value);
+  CHECK(dst[6] == 6);
+
+  // a summed saturated pixel stays saturated
+  std::vector<char> compressed16 = _compress(frame16);
+  Decompress::Message message16 = {compressed16.data(),compressed16.size(),2};
+  Decompress::Message message32 = {compressed.data(),compressed.size(),4};
+  Decompress::MessageList messages;
+  messages.push_back(message16);
+  messages.push_back(message32);
+  CHECK(Decompress::sumFrames(messages,dst.data(),NB_PIXELS * 4,
+			      NULL,NULL,saturated_value) >= 0);
+  CHECK(dst[5] == saturated_value);
+  CHECK(dst[6] == 12);
+  CHECK(dst[3] == 0);
+}
+
+static void _check_narrow()
+{
+  std::vector<uint32_t> frame = _frame<uint32_t>();
+  frame[7] = 0x10000;
+  frame[8] = 0xfffe;
+  std::vector<char> compressed = _compress(frame);
+  std::vector<uint16_t> dst(NB_PIXELS);
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),4,
+				    dst.data(),NB_PIXELS * 2,2) >= 0);
+  CHECK(dst[5] == 0xffff);
+  CHECK(dst[7] == 0xffff);
+  CHECK(dst[8] == 0xfffe);
+  CHECK(dst[9] == 9);
+}
+
+static void _check_roi()
+{
+  std::vector<uint16_t> frame = _frame<uint16_t>();
+  std::vector<char> compressed = _compress(frame);
+  Decompress::Message message = {compressed.data(),compressed.size(),2};
+  Decompress::MessageList messages(1,message);
+  Roi roi(Point(2,1),Size(4,3));
+  std::vector<uint32_t> dst(4 * 3);
+  CHECK(Decompress::decompressFrames(messages,dst.data(),dst.size() * 4,4,
+				     Size(WIDTH,HEIGHT),roi) >= 0);
+  for(int y = 0;y < 3;++y)
+    for(int x = 0;x < 4;++x)
+      CHECK(dst[y * 4 + x] == frame[(y + 1) * WIDTH + x + 2]);
+  // the roi doesn't fit into the destination
+  CHECK(Decompress::decompressFrames(messages,dst.data(),dst.size() * 2,4,
+				     Size(WIDTH,HEIGHT),roi) < 0);
+}
+
+template<class T>
+static void _check_sparse(Data::TYPE type)
+{
+  std::vector<T> values(NB_PIXELS,0);
+  values[0] = 1,values[17] = 2,values[NB_PIXELS - 1] = 3;
+
+  Data frame;
+  frame.type = type;
+  frame.dimensions.push_back(WIDTH);
+  frame.dimensions.push_back(HEIGHT);
+  frame.frameNumber = 12;
+  Buffer* buffer = new Buffer(NB_PIXELS * sizeof(T));
+  frame.setBuffer(buffer);
+  buffer->unref();
+  memcpy(frame.data(),values.data(),NB_PIXELS * sizeof(T));
+
+  Data sparse;
+  CHECK(Decompress::toSparse(frame,0.1,sparse));
+  CHECK(sparse.type == Data::UINT32);
+  CHECK(sparse.dimensions.size() == 2 &&
+	sparse.dimensions[0] == 2 && sparse.dimensions[1] == 3);
+  CHECK(sparse.frameNumber == 12);
+  // rebuild the dense frame
+  std::vector<T> dense(NB_PIXELS,0);
+  const unsigned int* pairs = (const unsigned int*)sparse.data();
+  for(int i = 0;i < sparse.dimensions[1];++i)
+    if(pairs[2 * i] < (unsigned int)NB_PIXELS)
+      dense[pairs[2 * i]] = T(pairs[2 * i + 1]);
+  CHECK(dense == values);
+
+  // over the occupancy threshold
+  Data dense_frame;
+  CHECK(!Decompress::toSparse(frame,1. / NB_PIXELS,dense_frame));
+}
+
+static void _check_truncated()
+{
+  std::vector<uint32_t> frame = _frame<uint32_t>();
+  std::vector<char> compressed = _compress(frame);
+  std::vector<uint32_t> dst(NB_PIXELS);
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size() / 2,4,
+				    dst.data(),NB_PIXELS * 4,4) < 0);
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size() / 2,4,
+				    dst.data(),NB_PIXELS * 2,2) < 0);
+  // a complete message smaller than the frame
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),4,
+				    dst.data(),NB_PIXELS * 4 + 64,4) < 0);
+  // a destination smaller than the message
+  CHECK(Decompress::decompressFrame(compressed.data(),compressed.size(),4,
+				    dst.data(),NB_PIXELS * 2,4) < 0);
+}
+
+int main()
+{
+  _check_mask();
+  _check_saturated();
+  _check_narrow();
+  _check_roi();
+  _check_sparse<uint16_t>(Data::UINT16);
+  _check_sparse<uint32_t>(Data::UINT32);
+  _check_truncated();
+  printf("%s\n",nb_failed ? "FAILED" : "OK");
+  return nb_failed;
+}
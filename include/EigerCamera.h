@@ -38,6 +38,9 @@
 #include <eigerapi/EigerDefines.h>
 
 #include <ostream>
+#include <vector>
+#include <memory>
+#include <atomic>
 
 namespace eigerapi
 {
@@ -50,6 +53,16 @@ namespace lima
    {
      class SavingCtrlObj;
      class Stream;
+     template<class T> class FrameRing;
+     class AzimuthalIntegrator;
+     class SpotFinder;
+     class Recompress;
+     class RawDump;
+     class ParamCache;
+     class Future;
+     class FutureCompletion;
+     class HealthMonitor;
+     class StartupCache;
    /*******************************************************************
    * \class Camera
    * \brief object controlling the Eiger camera via EigerAPI
@@ -65,8 +78,72 @@ namespace lima
 
 		enum Status { Ready, Initialising, Exposure, Readout, Fault };
 		enum CompressionType {LZ4,BSLZ4};
+		enum DecompressionPlacement {PROCESSLIB,RECEIVE_THREAD,DEDICATED_POOL};
 
-			Camera(const std::string& detector_ip);
+		/// statistics computed while the frame is decompressed,
+		/// saturated (all-ones) pixels are excluded from sum and max
+		struct FrameStatistics
+		{
+		  FrameStatistics() : frame_nb(-1),sum(0),max(0),
+				      nb_saturated(0),nb_non_zero(0) {}
+		  int			frame_nb;
+		  unsigned long long	sum;
+		  unsigned int		max;
+		  int			nb_saturated;
+		  int			nb_non_zero;
+		};
+
+		/// one refresh of the health monitor, NaN if the request failed
+		struct HealthSample
+		{
+		  double	timestamp;
+		  double	temperature;
+		  double	humidity;
+		  bool		aged;	///< last sample of a monitor paused by the acquisition
+		};
+
+		/// compressed size of the stream frames, see getCompressionStatistics
+		struct CompressionStatistics
+		{
+		  CompressionStatistics() : nb_frames(0),mean_size(0.),mean_ratio(0.),
+					    min_ratio(0.),max_ratio(0.) {}
+		  int		nb_frames;
+		  double	mean_size;	///< bytes
+		  double	mean_ratio;	///< uncompressed / compressed size
+		  double	min_ratio;
+		  double	max_ratio;
+		};
+
+		/// internal trigger to first frame latency, see getTriggerLatency
+		struct TriggerLatency
+		{
+		  TriggerLatency() : nb_triggers(0),last(0.),mean(0.),min(0.),max(0.) {}
+		  int		nb_triggers;
+		  double	last;		///< seconds
+		  double	mean;
+		  double	min;
+		  double	max;
+		};
+
+		/// spot finding done while decompressing, see SpotFinder
+		struct SpotFindingParameters
+		{
+		  SpotFindingParameters() : active(false),half_box_size(3),
+					    sigma_threshold(3.),sigma_background(6.),
+					    min_count(2),min_pixels(2),hit_threshold(1),
+					    veto(false) {}
+		  bool		active;
+		  int		half_box_size;	///< local background box half size
+		  double	sigma_threshold;
+		  double	sigma_background; ///< dispersion threshold of the box
+		  int		min_count;	///< minimum value of a strong pixel
+		  int		min_pixels;	///< minimum number of pixels of a peak
+		  int		hit_threshold;	///< minimum number of peaks of a hit
+		  bool		veto;		///< don't give the no hit frames to Lima
+		};
+
+			Camera(const std::string& detector_ip,
+			       const std::string& startup_cache_dir = "");
 			~Camera();
 
 			void initialize();
@@ -124,6 +201,8 @@ namespace lima
 		    void getEfficiencyCorrection(bool& value);
 			void setPixelMask(bool);
 			void getPixelMask(bool&);
+			void setSoftwarePixelMask(bool);
+			void getSoftwarePixelMask(bool&) const;
 			void setThresholdEnergy(double);
 			void getThresholdEnergy(double&);
 			void setVirtualPixelCorrection(bool);
@@ -157,11 +236,89 @@ namespace lima
             void getPhiIncrement(double&);
             void setPhiStart(double);
             void getPhiStart(double&);
+
+			// -- asynchronous variants, the caller owns the returned future
+			Future* getTemperatureAsync();
+			Future* getHumidityAsync();
+			Future* getCamStatusAsync();
+			Future* setCountrateCorrectionAsync(bool);
+			Future* setFlatfieldCorrectionAsync(bool);
+			Future* setEfficiencyCorrectionAsync(bool);
+			Future* setPixelMaskAsync(bool);
+			Future* setVirtualPixelCorrectionAsync(bool);
+			Future* setThresholdEnergyAsync(double);
+			Future* setPhotonEnergyAsync(double);
+			Future* setWavelengthAsync(double);
+			Future* setBeamCenterXAsync(double);
+			Future* setBeamCenterYAsync(double);
+			Future* setDetectorDistanceAsync(double);
+			Future* disarmAsync();
             
 			void getCompression(bool&);
    			void setCompression(bool);
 			void getCompressionType(CompressionType&) const;
 			void setCompressionType(CompressionType);
+			void setStatisticsActive(bool);
+			void getStatisticsActive(bool&) const;
+			void getFrameStatistics(int frame_nb,FrameStatistics&) const;
+			void getLastFrameStatistics(FrameStatistics&) const;
+
+			void getCompressedHistoryMemory(int&) const;
+			void setCompressedHistoryMemory(int);
+			void getSoftwareSummation(int&) const;
+			void setSoftwareSummation(int);
+			void getSoftwareRoi(Roi&) const;
+			void setSoftwareRoi(const Roi&);
+			void getSparseThreshold(double&) const;
+			void setSparseThreshold(double);
+			void getVariableFrameShape(bool&) const;
+			void setVariableFrameShape(bool);
+			void getAzimuthalIntegration(int& nb_bins) const;
+			void setAzimuthalIntegration(int nb_bins);
+			void getRadialAxis(std::vector<double>& q) const;
+			void getRadialProfile(int frame_nb,std::vector<double>& profile) const;
+			void getLastRadialProfile(std::vector<double>& profile) const;
+			void getSpotFinding(SpotFindingParameters&) const;
+			void setSpotFinding(const SpotFindingParameters&);
+			void getFrameNbPeaks(int frame_nb,int& nb_peaks) const;
+			void getLastFrameNbPeaks(int& nb_peaks) const;
+			void getNbVetoedFrames(int&) const;
+			void getAdaptiveImageType(bool&) const;
+			void setAdaptiveImageType(bool);
+			void getSaturatedPixelValue(int&) const;
+			void setSaturatedPixelValue(int);
+			void getRecompression(bool&) const;
+			void setRecompression(bool);
+			void getRecompressionType(CompressionType&) const;
+			void setRecompressionType(CompressionType);
+			void getRecompressionNbThreads(int&) const;
+			void setRecompressionNbThreads(int);
+			void getRawDumpFile(std::string&) const;
+			void setRawDumpFile(const std::string&);
+			void getCompressionStatistics(CompressionStatistics&) const;
+			void getCompressionRatioHistogram(std::vector<int>&) const;
+			void getFrameCompressedSize(int frame_nb,int& size) const;
+			void resetCompressionStatistics();
+			void getDecompressionPlacement(DecompressionPlacement&) const;
+			void setDecompressionPlacement(DecompressionPlacement);
+			void getDecompressionPool(int& nb_threads,unsigned long long& cpu_mask) const;
+			void setDecompressionPool(int nb_threads,unsigned long long cpu_mask = 0);
+			void invalidateParamCache();
+			void beginConfiguration();
+			void commitConfiguration();
+			void abortConfiguration();
+			void getNbImagesPerTrigger(int&) const;
+			void setNbImagesPerTrigger(int);
+			void getNbTriggersPerArm(int&) const;
+			void setNbTriggersPerArm(int);
+			void getHealthMonitorPeriod(double& period,double& acq_period) const;
+			void setHealthMonitorPeriod(double period,double acq_period = 0.);
+			void getHealthHistory(std::vector<HealthSample>&) const;
+			bool getLastHealthSample(HealthSample&) const;
+			void getPipelinedTriggers(bool&) const;
+			void setPipelinedTriggers(bool);
+			void getTriggerLatency(TriggerLatency&) const;
+			void resetTriggerLatency();
 			void getSerieId(int&);
 			void deleteMemoryFiles();
 			void disarm();
@@ -173,8 +330,23 @@ namespace lima
 			friend class AcqCallback;
 			class InitCallback;
 			friend class InitCallback;
+			class ConfigTransaction;
+			class TriggerSender;
 			void initialiseController(); /// Used during plug-in initialization
 			void _acquisition_finished(bool);
+			void _prepare_azimuthal_integration();
+			bool _summation_fits_16_bits() const;
+			void _prepare_raw_dump();
+			void _compressed_frame(int frame_nb,size_t compressed_size,int frame_size);
+			void _prebuild_trigger();
+			void _send_trigger(AutoMutex&);
+			void _frame_received(double timestamp);
+			void _resynchronize(const ConfigTransaction&);
+			void _config_changed();
+			static void* _startupFunc(void*);
+			void _startup();
+			void _wait_startup();
+			void _save_startup_cache();
 			//-----------------------------------------------------------------------------
 			//- lima stuff
 			int                       m_nb_frames;
@@ -199,9 +371,65 @@ namespace lima
 			double                    m_exp_time;
 			double		          m_readout_time;
 			double                    m_x_pixelsize, m_y_pixelsize;
-			Cond			  m_cond;
+			mutable Cond		  m_cond;
 			std::string		  m_detector_ip;
 			double			  m_min_frame_time;
+			int			  m_compressed_history_memory;
+			bool			  m_software_pixel_mask;
+			bool			  m_statistics_active;
+			FrameRing<FrameStatistics>* m_statistics;
+			int			  m_software_summation;
+			Roi			  m_software_roi;
+			double			  m_sparse_threshold;
+			bool			  m_variable_frame_shape;
+			int			  m_azimuthal_nb_bins;
+			AzimuthalIntegrator*	  m_azimuthal_integrator;
+			SpotFindingParameters	  m_spot_finding;
+			SpotFinder*		  m_spot_finder;
+			FrameRing<int>*		  m_nb_peaks;
+			std::atomic<int>	  m_nb_vetoed_frames;
+			bool			  m_adaptive_image_type;
+			int			  m_bit_depth_readout;
+			int			  m_saturated_pixel_value;
+			bool			  m_recompression_active;
+			CompressionType		  m_recompression_type;
+			int			  m_recompression_nb_threads;
+			Recompress*		  m_recompress;
+			std::string		  m_raw_dump_filename;
+			mutable Mutex		  m_raw_dump_mutex;
+			std::shared_ptr<RawDump>  m_raw_dump;
+			mutable Mutex		  m_compression_mutex;
+			CompressionStatistics	  m_compression_statistics;
+			std::vector<int>	  m_compression_histogram;
+			FrameRing<int>*		  m_compressed_sizes;
+			DecompressionPlacement	  m_decompression_placement;
+			int			  m_decompression_nb_threads;
+			unsigned long long	  m_decompression_cpu_mask;
+			ParamCache*		  m_param_cache;
+			mutable Mutex		  m_config_mutex;
+			ConfigTransaction*	  m_config_transaction;
+			int			  m_nb_images_per_trigger;
+			int			  m_nb_triggers_per_arm;
+			int			  m_armed_nb_triggers_left;
+			double			  m_armed_frame_time;
+			int			  m_armed_nb_frames;
+			unsigned		  m_armed_nb_trigger;
+			int			  m_armed_frame_offset;
+			std::atomic<bool>	  m_config_dirty;
+			std::atomic<bool>	  m_pixel_mask_changed;
+			FutureCompletion*	  m_future_completion;
+			HealthMonitor*		  m_health_monitor;
+			StartupCache*		  m_startup_cache;
+			bool			  m_startup_running;
+			bool			  m_startup_thread_started;
+			pthread_t		  m_startup_thread;
+			bool			  m_pipelined_triggers;
+			int			  m_nb_triggers_in_flight;
+			TriggerSender*		  m_trigger_sender;
+			double			  m_trigger_timestamp;
+			std::atomic<bool>	  m_trigger_pending;
+			mutable Mutex		  m_trigger_latency_mutex;
+			TriggerLatency		  m_trigger_latency;
 			
 	};
 	} // namespace Eiger
@@ -0,0 +1,84 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2014
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERFUTURE_H
+#define EIGERFUTURE_H
+
+#include "EigerCompatibility.h"
+
+#include <memory>
+#include <string>
+
+#include "lima/Debug.h"
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /*******************************************************************
+     * \class Future
+     * \brief result of an asynchronous detector request
+     *
+     * returned by the Camera *Async methods, the caller owns it.
+     * A future must not outlive its Camera.
+     *******************************************************************/
+    class LIBEIGER Future
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"Future","Eiger");
+      friend class Camera;
+    public:
+      enum Status {Running,Done,Failed,Cancelled};
+      enum ValueType {None,Bool,Double,String};
+
+      /// called once when the request is finished, from the completion thread
+      class Callback
+      {
+      public:
+	virtual ~Callback() {}
+	virtual void done(Future&) = 0;
+      };
+
+      ~Future();
+
+      Status getStatus() const;
+      bool isDone() const;
+      void wait(double timeout = -1.) const;
+      void cancel();
+
+      ValueType getValueType() const;
+      void getValue(bool&) const;
+      void getValue(double&) const;
+      void getValue(std::string&) const;
+      std::string getErrorMessage() const;
+
+      void setCallback(Callback*);
+
+      struct Impl;
+    private:
+      Future(std::shared_ptr<Impl>);
+      Future(const Future&);
+      Future& operator=(const Future&);
+
+      std::shared_ptr<Impl> m_impl;
+    };
+  }
+}
+#endif	// EIGERFUTURE_H
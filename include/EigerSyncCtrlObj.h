@@ -57,6 +57,9 @@ namespace lima
 	    virtual void setNbHwFrames(int  nb_frames);
 	    virtual void getNbHwFrames(int& nb_frames);
 
+	    void setNbImagesPerTrigger(int nb_images);
+	    void getNbImagesPerTrigger(int& nb_images);
+
 	    virtual void getValidRanges(ValidRangesType& valid_ranges);
 
 	private:
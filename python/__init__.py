@@ -38,3 +38,66 @@ module_helper.load_cleanup(cleanup_data)
 
 del mod_path, depends_on, has_dependent, cleanup_data
 del module_helper
+
+def sparse_to_dense(pairs, width, height, dtype='uint32'):
+    """Rebuild a dense frame from a sparse one (see Camera.setSparseThreshold).
+
+    pairs is the (nb_pixels, 2) array of (pixel index, value), width, height
+    and dtype are the frame header keys sparse_width, sparse_height and
+    sparse_type.
+    """
+    import numpy
+    dense = numpy.zeros(int(width) * int(height), dtype=dtype)
+    dense[pairs[:, 0]] = pairs[:, 1]
+    return dense.reshape(int(height), int(width))
+
+def read_raw_dump(filename):
+    """Map a raw dump file (see Camera.setRawDumpFile).
+
+    return the (nb_frames, height, width) frames and the index, a record
+    array of (frame_nb, offset, timestamp), frame_nb is -1 for the frames
+    which were not written.
+    """
+    import numpy
+    header_dtype = numpy.dtype([('magic', 'S8'), ('version', '<u4'),
+                                ('nb_frames', '<u4'), ('width', '<u4'),
+                                ('height', '<u4'), ('depth', '<u4'),
+                                ('reserved', '<u4'), ('frame_size', '<u8')])
+    entry_dtype = numpy.dtype([('frame_nb', '<i8'), ('offset', '<u8'),
+                               ('timestamp', '<f8')])
+    header = numpy.fromfile(filename + '.index', dtype=header_dtype, count=1)[0]
+    if header['magic'] != b'EIGERRAW':
+        raise ValueError('%s is not a raw dump index' % (filename + '.index'))
+    index = numpy.fromfile(filename + '.index', dtype=entry_dtype,
+                           count=int(header['nb_frames']),
+                           offset=header_dtype.itemsize)
+    frame_dtype = 'uint16' if header['depth'] == 2 else 'uint32'
+    frames = numpy.memmap(filename, dtype=frame_dtype, mode='r',
+                          shape=(int(header['nb_frames']), int(header['height']),
+                                 int(header['width'])))
+    return frames, index
+
+class _ConcurrentCallback(Future.Callback):
+    def __init__(self, future):
+        Future.Callback.__init__(self)
+        import concurrent.futures
+        self.future = future
+        self.result = concurrent.futures.Future()
+        self.result.set_running_or_notify_cancel()
+        # keep the request alive as long as its result is referenced
+        self.result._eiger_callback = self
+        future.setCallback(self)
+
+    def done(self, future):
+        try:
+            self.result.set_result(future.result(0))
+        except Exception as e:
+            self.result.set_exception(e)
+
+def as_concurrent_future(future):
+    """Wrap a Future returned by a Camera *Async method (see Future.setCallback).
+
+    return a concurrent.futures.Future set from the completion thread, use
+    asyncio.wrap_future on it to await the request in an event loop.
+    """
+    return _ConcurrentCallback(future).result
@@ -19,6 +19,9 @@
 // You should have received a copy of the GNU General Public License
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
+#ifndef _CURLLOOP_H
+#define _CURLLOOP_H
+
 #include <pthread.h>
 #include <curl/curl.h>
 
@@ -94,3 +97,4 @@ namespace eigerapi
     ListRequests	m_cancel_requests;
   };
 }
+#endif	// _CURLLOOP_H
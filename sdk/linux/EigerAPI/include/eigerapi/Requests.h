@@ -19,6 +19,9 @@
 // You should have received a copy of the GNU General Public License
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
+#ifndef _REQUESTS_H
+#define _REQUESTS_H
+
 #include <string>
 #include <map>
 #include <vector>
@@ -71,6 +74,9 @@ namespace eigerapi
 		    bool lock = true);
       Value get_max(double timeout = CurlLoop::FutureRequest::TIMEOUT,
 		    bool lock = true);
+      // after wait(), the parameters the detector changed with a set
+      // request (false if the reply has no list)
+      bool get_changed_params(std::vector<std::string>&) const;
     private:
       void _fill_get_request();
       template <class T>
@@ -83,6 +89,7 @@ namespace eigerapi
       void _set_return_value(std::string&);
 
       virtual void _request_finished();
+      void _read_changed_params();
 
       static size_t _write_callback(char*, size_t, size_t, void*);
 
@@ -94,6 +101,9 @@ namespace eigerapi
       struct curl_slist*	m_headers;
       VALUE_TYPE		m_return_type;
       void*			m_return_value;
+      bool			m_set_request;
+      bool			m_has_changed_params;
+      std::vector<std::string>	m_changed_params;
     };
     
     class Transfer : public CurlLoop::FutureRequest
@@ -169,12 +179,23 @@ namespace eigerapi
 		     HEADER_PHI_START,
 		     HEADER_WAVELENGTH,
 		     COMPRESSION_TYPE,
+		     FRAME_COUNT_TIME,
+		     NFRAMES_SUM,
+		     COUNTRATE_CORRECTION_CUTOFF,
     };
 
-    Requests(const std::string& address);
+    // with a known api_version, the version request is not sent
+    Requests(const std::string& address,const std::string& api_version = "");
     ~Requests();
 
+    const std::string& get_api_version() const {return m_api_version;}
+    // api version the detector runs now, the urls keep get_api_version
+    std::shared_ptr<Param> get_detector_api_version(std::string&);
+
     std::shared_ptr<Command> get_command(COMMAND_NAME);
+    // build a command without sending it, see submit
+    std::shared_ptr<Command> create_command(COMMAND_NAME);
+    void submit(std::shared_ptr<CurlLoop::FutureRequest>);
     std::shared_ptr<Param> get_param(PARAM_NAME);
     std::shared_ptr<Param> get_param(PARAM_NAME,bool&);
     std::shared_ptr<Param> get_param(PARAM_NAME,double&);
@@ -196,8 +217,15 @@ namespace eigerapi
 							 bool full_url = false);
     
     void cancel(std::shared_ptr<CurlLoop::FutureRequest> request);
+
+    // parameter named name in the same subsystem as param
+    static bool find_param(PARAM_NAME param,const std::string& name,
+			   PARAM_NAME& found);
+    // detector resource name of param
+    static const char* param_name(PARAM_NAME param);
   private:
     std::shared_ptr<Param> _create_get_param(PARAM_NAME);
+    std::shared_ptr<Param> _create_version_request();
     template <class T>
     std::shared_ptr<Param> _set_param(PARAM_NAME,const T&);
 
@@ -207,5 +235,7 @@ namespace eigerapi
     CACHE_TYPE	m_cmd_cache_url;
     CACHE_TYPE	m_param_cache_url;
     std::string m_address;
+    std::string m_api_version;
   };
 }
+#endif	// _REQUESTS_H
@@ -207,12 +207,18 @@ void CurlLoop::_run()
 	    __FILE__ << ":" << __LINE__ << ", exit" << std::endl;
 	  break;
 	}
-      // fds are not ready in curl, wait 100ms
-      int nb_event = 0;
-      if(max_fd == -1)
-	usleep(100 * 1000);
-      else
-	nb_event = select(max_fd + 1,&fdread,&fdwrite,&fdexcep,timeoutPt);
+      // fds are not ready in curl (e.g. a new request not connected yet),
+      // wait what curl asks (0 for new requests), at most 100ms, or a
+      // new request on the pipe
+      if(max_fd == -1 && (curl_timeout < 0 || curl_timeout > 100))
+	{
+	  timeout.tv_sec = 0;
+	  timeout.tv_usec = 100 * 1000;
+	  timeoutPt = &timeout;
+	}
+      if(max_fd < m_pipes[0])
+	max_fd = m_pipes[0];
+      int nb_event = select(max_fd + 1,&fdread,&fdwrite,&fdexcep,timeoutPt);
 	
       if(nb_event == -1)
 	{
@@ -223,7 +229,7 @@ void CurlLoop::_run()
 	      break;
 	    }
 	}
-      else if(nb_event >= 0 || max_fd == -1)
+      else
 	{
 	  // flush pipe
 	  char buffer[1024];
@@ -180,6 +180,10 @@ ParamIndex ParamDescription[] = {
   {Requests::HEADER_WAVELENGTH,			{"wavelength"}},
   // Compression
   {Requests::COMPRESSION_TYPE,			{"compression"}},
+  // Read only values listed as changed by the timing and auto summation sets
+  {Requests::FRAME_COUNT_TIME,			{"frame_count_time"}},
+  {Requests::NFRAMES_SUM,			{"nframes_sum"}},
+  {Requests::COUNTRATE_CORRECTION_CUTOFF,	{"countrate_correction_count_cutoff"}},
 };
 
 const char* get_param_name(Requests::PARAM_NAME param_name)
@@ -205,25 +209,24 @@ std::string ResourceDescription::build_url(const std::ostringstream& base_url,
 }
 
 // Requests class
-Requests::Requests(const std::string& address) :
-  m_address(address)
+Requests::Requests(const std::string& address,const std::string& api_version) :
+  m_address(address),
+  m_api_version(api_version)
 {
   std::ostringstream base_url;
   base_url << "http://" << address << '/';
 
-  std::ostringstream url;
-  url  << base_url.str() << CSTR_SUBSYSTEMDETECTOR << '/'
-       << CSTR_EIGERAPI << '/' << CSTR_EIGERVERSION << '/';
-  
-  std::shared_ptr<Param> version_request(new Param(url.str()));
-  version_request->_fill_get_request();
-  m_loop.add_request(version_request);
+  if(m_api_version.empty())
+    {
+      std::shared_ptr<Param> version_request = _create_version_request();
+      m_loop.add_request(version_request);
   
-  Requests::Param::Value value = version_request->get();
-  std::string& api_version = value.string_val;
+      Requests::Param::Value value = version_request->get();
+      m_api_version = value.string_val;
+    }
   
   std::ostringstream api;
-  api << '/' << CSTR_EIGERAPI << '/' << api_version << '/';
+  api << '/' << CSTR_EIGERAPI << '/' << m_api_version << '/';
   
   // COMMANDS URL CACHE
   int nb_cmd = sizeof(CommandsDescription) / sizeof(CommandIndex);
@@ -247,6 +250,14 @@ Requests::~Requests()
 
 std::shared_ptr<Requests::Command>
 Requests::get_command(Requests::COMMAND_NAME cmd_name)
+{
+  std::shared_ptr<Requests::Command> cmd = create_command(cmd_name);
+  m_loop.add_request(cmd);
+  return cmd;
+}
+
+std::shared_ptr<Requests::Command>
+Requests::create_command(Requests::COMMAND_NAME cmd_name)
 {
   CACHE_TYPE::iterator cmd_url = m_cmd_cache_url.find(cmd_name);
   if(cmd_url == m_cmd_cache_url.end())
@@ -254,8 +265,12 @@ Requests::get_command(Requests::COMMAND_NAME cmd_name)
 
   std::shared_ptr<Requests::Command> cmd(new Command(cmd_url->second));
   cmd->_fill_request();
-  m_loop.add_request(cmd);
-  return move(cmd);
+  return cmd;
+}
+
+void Requests::submit(std::shared_ptr<CurlLoop::FutureRequest> request)
+{
+  m_loop.add_request(request);
 }
 
 std::shared_ptr<Requests::Param>
@@ -308,6 +323,28 @@ Requests::get_param(Requests::PARAM_NAME param_name,
   GENERATE_GET_PARAM();
 }
 
+std::shared_ptr<Requests::Param>
+Requests::get_detector_api_version(std::string& ret_value)
+{
+  std::shared_ptr<Requests::Param> param = _create_version_request();
+  param->_set_return_value(ret_value);
+
+  m_loop.add_request(param);
+  return param;
+}
+
+std::shared_ptr<Requests::Param>
+Requests::_create_version_request()
+{
+  std::ostringstream url;
+  url << "http://" << m_address << '/' << CSTR_SUBSYSTEMDETECTOR << '/'
+      << CSTR_EIGERAPI << '/' << CSTR_EIGERVERSION << '/';
+
+  std::shared_ptr<Requests::Param> param(new Param(url.str()));
+  param->_fill_get_request();
+  return param;
+}
+
 std::shared_ptr<Requests::Param>
 Requests::_create_get_param(Requests::PARAM_NAME param_name)
 {
@@ -410,6 +447,36 @@ void Requests::cancel(std::shared_ptr<CurlLoop::FutureRequest> req)
 {
   m_loop.cancel_request(req);
 }
+
+const char* Requests::param_name(PARAM_NAME param)
+{
+  return get_param_name(param);
+}
+
+bool Requests::find_param(PARAM_NAME param,const std::string& name,
+			  PARAM_NAME& found)
+{
+  int nb_params = sizeof(ParamDescription) / sizeof(ParamIndex);
+  const ResourceDescription* param_desc = NULL;
+  for(int i = 0;i < nb_params && !param_desc;++i)
+    if(ParamDescription[i].name == param)
+      param_desc = &ParamDescription[i].desc;
+  if(!param_desc)
+    return false;
+
+  for(int i = 0;i < nb_params;++i)
+    {
+      const ResourceDescription& desc = ParamDescription[i].desc;
+      if(name == desc.m_name &&
+	 !strcmp(desc.m_subsystem,param_desc->m_subsystem) &&
+	 !strcmp(desc.m_location,param_desc->m_location))
+	{
+	  found = ParamDescription[i].name;
+	  return true;
+	}
+    }
+  return false;
+}
 //Class Command
 Requests::Command::Command(const std::string& url) :
   CurlLoop::FutureRequest(url)
@@ -455,7 +522,9 @@ Requests::Param::Param(const std::string& url) :
   m_data_size(0),
   m_data_memorysize(0),
   m_headers(NULL),
-  m_return_value(NULL)
+  m_return_value(NULL),
+  m_set_request(false),
+  m_has_changed_params(false)
 {
 }
 
@@ -574,6 +643,7 @@ void Requests::Param::_fill_set_request(const T& value)
   curl_easy_setopt(m_handle, CURLOPT_HTTPHEADER, m_headers);
   curl_easy_setopt(m_handle, CURLOPT_CUSTOMREQUEST, "PUT"); 
   curl_easy_setopt(m_handle, CURLOPT_FAILONERROR, true);
+  m_set_request = true;
 
   m_data_buffer = strdup(json_struct.c_str()),m_data_memorysize = json_struct.length();
   curl_easy_setopt(m_handle, CURLOPT_POSTFIELDS, m_data_buffer); // data goes here
@@ -613,6 +683,9 @@ void Requests::Param::_request_finished()
 {
   if(m_status == CANCEL) return;
 
+  if(m_set_request)
+    _read_changed_params();
+
   std::string error_string;
   if(m_return_value)
     {
@@ -719,6 +792,35 @@ void Requests::Param::_request_finished()
   m_status = ERROR;
 }
 
+/** a set reply is the list of the parameters changed by the set
+ *  (simplon api >= 1.6), older detectors reply nothing.
+ */
+void Requests::Param::_read_changed_params()
+{
+  if(m_status != OK || m_data_size <= 0)
+    return;
+
+  Json::Value root;
+  Json::Reader reader;
+  std::string reply(m_data_buffer,m_data_size);
+  if(!reader.parse(reply,root) || !root.isArray())
+    return;
+
+  int array_size = root.size();
+  for(int i = 0;i < array_size;++i)
+    m_changed_params.push_back(root[i].asString());
+  m_has_changed_params = true;
+}
+
+bool Requests::Param::get_changed_params(std::vector<std::string>& params) const
+{
+  Lock lock(&m_lock);
+  if(!m_has_changed_params)
+    return false;
+  params = m_changed_params;
+  return true;
+}
+
 size_t Requests::Param::_write_callback(char *ptr,size_t size,
 					size_t nmemb,void *userdata)
 {
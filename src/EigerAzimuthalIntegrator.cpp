@@ -0,0 +1,235 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <math.h>
+#include <algorithm>
+
+#include "lima/Exceptions.h"
+#include "EigerAzimuthalIntegrator.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+AzimuthalIntegrator::Geometry::Geometry() :
+  beam_center_x(0.),beam_center_y(0.),
+  distance(0.),wavelength(0.),
+  pixel_size_x(0.),pixel_size_y(0.),
+  nb_bins(0)
+{
+}
+
+bool AzimuthalIntegrator::Geometry::operator==(const Geometry& o) const
+{
+  return (frame_size == o.frame_size &&
+	  frame_offset == o.frame_offset &&
+	  beam_center_x == o.beam_center_x &&
+	  beam_center_y == o.beam_center_y &&
+	  distance == o.distance &&
+	  wavelength == o.wavelength &&
+	  pixel_size_x == o.pixel_size_x &&
+	  pixel_size_y == o.pixel_size_y &&
+	  nb_bins == o.nb_bins);
+}
+
+AzimuthalIntegrator::AzimuthalIntegrator(int nb_profiles) :
+  m_nb_profiles(nb_profiles),
+  m_last_frame(-1)
+{
+}
+
+/** @brief build the pixel to bin lookup table.
+ *
+ *  bins are uniform in q = 4 pi sin(theta) / wavelength between 0 and the
+ *  q of the farthest pixel. The table is only rebuilt if the geometry changed.
+ */
+void AzimuthalIntegrator::setGeometry(const Geometry& geometry)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR4(geometry.frame_size,geometry.beam_center_x,
+			  geometry.beam_center_y,geometry.nb_bins);
+
+  {
+    AutoMutex lock(m_mutex);
+    if(m_table && geometry == m_table->geometry)
+      return;
+  }
+  if(geometry.nb_bins <= 0 || geometry.distance <= 0. || geometry.wavelength <= 0.)
+    THROW_HW_ERROR(InvalidValue) << "Wrong azimuthal integration geometry: "
+				 << DEB_VAR3(geometry.nb_bins,geometry.distance,
+					     geometry.wavelength);
+
+  int width = geometry.frame_size.getWidth();
+  int height = geometry.frame_size.getHeight();
+  int nb_pixels = width * height;
+  std::vector<double> pixel_q(nb_pixels);
+  double q_max = 0.;
+  for(int y = 0;y < height;++y)
+    {
+      double dy = (geometry.frame_offset.y + y + 0.5 - geometry.beam_center_y) *
+	geometry.pixel_size_y;
+      for(int x = 0;x < width;++x)
+	{
+	  double dx = (geometry.frame_offset.x + x + 0.5 - geometry.beam_center_x) *
+	    geometry.pixel_size_x;
+	  double two_theta = atan2(sqrt(dx * dx + dy * dy),geometry.distance);
+	  double q = 4 * M_PI * sin(two_theta / 2) / geometry.wavelength;
+	  pixel_q[y * width + x] = q;
+	  if(q > q_max) q_max = q;
+	}
+    }
+
+  int nb_bins = geometry.nb_bins;
+  double bin_width = q_max > 0. ? q_max / nb_bins : 1.;
+  std::vector<int> pixel_bin(nb_pixels);
+  std::vector<int> bin_start(nb_bins + 1,0);
+  for(int i = 0;i < nb_pixels;++i)
+    {
+      int bin = std::min(int(pixel_q[i] / bin_width),nb_bins - 1);
+      pixel_bin[i] = bin;
+      ++bin_start[bin + 1];
+    }
+  for(int bin = 0;bin < nb_bins;++bin)
+    bin_start[bin + 1] += bin_start[bin];
+
+  std::shared_ptr<_Table> table(new _Table());
+  table->pixel_index.resize(nb_pixels);
+  std::vector<int> fill(bin_start.begin(),bin_start.end() - 1);
+  for(int i = 0;i < nb_pixels;++i)
+    table->pixel_index[fill[pixel_bin[i]]++] = i;
+
+  table->q.resize(nb_bins);
+  for(int bin = 0;bin < nb_bins;++bin)
+    table->q[bin] = (bin + 0.5) * bin_width;
+
+  table->bin_start.swap(bin_start);
+  table->geometry = geometry;
+
+  AutoMutex lock(m_mutex);
+  m_table = table;
+  m_profiles.assign(size_t(m_nb_profiles) * nb_bins,0.f);
+  m_frame_nbs.assign(m_nb_profiles,-1);
+  m_last_frame = -1;
+}
+
+void AzimuthalIntegrator::clear()
+{
+  AutoMutex lock(m_mutex);
+  m_frame_nbs.assign(m_frame_nbs.size(),-1);
+  m_last_frame = -1;
+}
+
+/** mean of the valid pixels of each bin, saturated (or invalid) pixels
+ *  and masked pixels (if masked isn't NULL) are excluded.
+ *  the inner loop is a branch-less gather-sum the compiler can vectorize.
+ */
+template<class T>
+void AzimuthalIntegrator::_integrate(const _Table& table,const T* data,T saturated,
+				     const unsigned char* masked,float* profile)
+{
+  const int* pixel_index = table.pixel_index.data();
+  const int* bin_start = table.bin_start.data();
+  int nb_bins = table.geometry.nb_bins;
+  for(int bin = 0;bin < nb_bins;++bin)
+    {
+      double sum = 0.;
+      int nb_valid = 0;
+      int start = bin_start[bin],end = bin_start[bin + 1];
+      if(masked)
+	for(int k = start;k < end;++k)
+	  {
+	    int index = pixel_index[k];
+	    T value = data[index];
+	    int valid = (value != saturated) & !masked[index];
+	    sum += valid ? value : 0;
+	    nb_valid += valid;
+	  }
+      else
+	for(int k = start;k < end;++k)
+	  {
+	    T value = data[pixel_index[k]];
+	    int valid = value != saturated;
+	    sum += valid ? value : 0;
+	    nb_valid += valid;
+	  }
+      profile[bin] = nb_valid ? float(sum / nb_valid) : 0.f;
+    }
+}
+
+/** @brief radial profile of a frame.
+ *
+ *  saturated is the value of the saturated and invalid pixels in this
+ *  frame, masked the masked pixels of the frame (one byte per pixel).
+ */
+void AzimuthalIntegrator::integrate(int frame_nb,const void* data,int depth,
+				    unsigned int saturated,const unsigned char* masked)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_mutex);
+  std::shared_ptr<const _Table> table = m_table;
+  lock.unlock();
+  if(!table || frame_nb < 0) return;
+
+  int nb_bins = table->geometry.nb_bins;
+  std::vector<float> profile(nb_bins);
+  if(depth == 2)
+    _integrate(*table,(const unsigned short*)data,(unsigned short)saturated,masked,
+	       profile.data());
+  else if(depth == 4)
+    _integrate(*table,(const unsigned int*)data,saturated,masked,profile.data());
+  else
+    return;
+
+  lock.lock();
+  // the geometry changed meanwhile, the profile ring was resized
+  if(table != m_table) return;
+  int slot = frame_nb % m_nb_profiles;
+  std::copy(profile.begin(),profile.end(),m_profiles.begin() + size_t(slot) * nb_bins);
+  m_frame_nbs[slot] = frame_nb;
+  if(frame_nb > m_last_frame) m_last_frame = frame_nb;
+}
+
+bool AzimuthalIntegrator::getProfile(int frame_nb,std::vector<double>& profile) const
+{
+  AutoMutex lock(m_mutex);
+  if(frame_nb < 0 || !m_table) return false;
+  int slot = frame_nb % m_nb_profiles;
+  if(m_frame_nbs[slot] != frame_nb) return false;
+
+  int nb_bins = m_table->geometry.nb_bins;
+  std::vector<float>::const_iterator begin = m_profiles.begin() + size_t(slot) * nb_bins;
+  profile.assign(begin,begin + nb_bins);
+  return true;
+}
+
+int AzimuthalIntegrator::lastFrame() const
+{
+  AutoMutex lock(m_mutex);
+  return m_last_frame;
+}
+
+void AzimuthalIntegrator::getRadialAxis(std::vector<double>& q) const
+{
+  AutoMutex lock(m_mutex);
+  if(m_table)
+    q = m_table->q;
+  else
+    q.clear();
+}
@@ -0,0 +1,96 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERAZIMUTHALINTEGRATOR_H
+#define EIGERAZIMUTHALINTEGRATOR_H
+
+#include <vector>
+#include <memory>
+
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Radial profile of decompressed frames.
+     *
+     *  each pixel belongs to one q bin, the lookup table is stored bin by
+     *  bin (compressed sparse rows) so a bin is a gather-sum over its pixels.
+     *  Profiles of the last frames are kept in a fixed size ring.
+     *  The lookup table is never modified, a new geometry replaces it
+     *  and frames being integrated keep the previous one.
+     */
+    class AzimuthalIntegrator
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"AzimuthalIntegrator","Eiger");
+    public:
+      struct Geometry
+      {
+	Geometry();
+	bool operator==(const Geometry&) const;
+
+	Size	frame_size;
+	Point	frame_offset;	///< top left of the frame (software roi)
+	double	beam_center_x;	///< pixel
+	double	beam_center_y;	///< pixel
+	double	distance;	///< m
+	double	wavelength;	///< Angstrom
+	double	pixel_size_x;	///< m
+	double	pixel_size_y;	///< m
+	int	nb_bins;
+      };
+
+      AzimuthalIntegrator(int nb_profiles);
+
+      void setGeometry(const Geometry&);
+      void clear();
+
+      void integrate(int frame_nb,const void* data,int depth,
+		     unsigned int saturated,const unsigned char* masked = NULL);
+
+      bool getProfile(int frame_nb,std::vector<double>& profile) const;
+      int lastFrame() const;
+      void getRadialAxis(std::vector<double>& q) const;
+    private:
+      struct _Table
+      {
+	Geometry		geometry;
+	std::vector<int>	bin_start;
+	std::vector<int>	pixel_index;
+	std::vector<double>	q;
+      };
+      template<class T>
+      static void _integrate(const _Table&,const T* data,T saturated,
+			     const unsigned char* masked,float* profile);
+
+      mutable Mutex		m_mutex;
+      std::shared_ptr<const _Table> m_table;
+      int			m_nb_profiles;
+      std::vector<float>	m_profiles;
+      std::vector<int>		m_frame_nbs;
+      int			m_last_frame;
+    };
+  }
+}
+#endif	// EIGERAZIMUTHALINTEGRATOR_H
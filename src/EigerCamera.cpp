@@ -25,7 +25,17 @@
 #include <string>
 #include <math.h>
 #include <algorithm>
+#include <functional>
 #include "EigerCamera.h"
+#include "EigerFrameRing.h"
+#include "EigerAzimuthalIntegrator.h"
+#include "EigerSpotFinder.h"
+#include "EigerRecompress.h"
+#include "EigerRawDump.h"
+#include "EigerParamCache.h"
+#include "EigerFutureImpl.h"
+#include "EigerHealthMonitor.h"
+#include "EigerStartupCache.h"
 #include <eigerapi/Requests.h>
 #include "lima/Timestamp.h"
 
@@ -57,17 +67,30 @@ THROW_HW_ERROR(Error) << __errMsg__;		\
 #define EIGER_SYNC_CMD(CommandType)		\
   EIGER_SYNC_CMD_TIMEOUT(CommandType,CurlLoop::FutureRequest::TIMEOUT)
   
+// within a configuration transaction, the change is only staged
 #define EIGER_SYNC_SET_PARAM(ParamType,value)				\
   {									\
-    std::shared_ptr<Requests::Param> req =				\
-      m_requests->set_param(ParamType,value);				\
-    try									\
-      {									\
-	req->wait();							\
-      }									\
-    catch(const eigerapi::EigerException &e)				\
+    _wait_startup();							\
+    AutoMutex config_lock(m_config_mutex);				\
+    if(m_config_transaction)						\
+      m_config_transaction->stage(ParamType,value);			\
+    else								\
       {									\
-	HANDLE_EIGERERROR(e.what());					\
+	config_lock.unlock();						\
+	std::shared_ptr<Requests::Param> req =				\
+	  m_requests->set_param(ParamType,value);			\
+	try								\
+	  {								\
+	    req->wait();						\
+	  }								\
+	catch(const eigerapi::EigerException &e)			\
+	  {								\
+	    HANDLE_EIGERERROR(e.what());				\
+	  }								\
+	m_param_cache->changed(*m_requests,req,ParamType,value);	\
+	/* header parameters are metadata, they keep the armed series */ \
+	if(!ParamCache::isHeaderParam(ParamType))			\
+	  _config_changed();						\
       }									\
   }
 
@@ -86,6 +109,59 @@ THROW_HW_ERROR(Error) << __errMsg__;		\
       }									\
   }
 
+#define EIGER_CACHED_GET_PARAM(ParamType,value)				\
+  {									\
+    if(!m_param_cache->get(ParamType,value))				\
+      {									\
+	EIGER_SYNC_GET_PARAM(ParamType,value);				\
+	m_param_cache->set(ParamType,value);				\
+      }									\
+  }
+
+// the request is sent at once, the caller owns the returned future
+#define EIGER_ASYNC_SET_PARAM(ParamType,value)				\
+  {									\
+    _wait_startup();							\
+    {									\
+      AutoMutex config_lock(m_config_mutex);				\
+      if(m_config_transaction)						\
+	THROW_HW_ERROR(Error) << "Asynchronous set in a configuration transaction"; \
+    }									\
+    std::shared_ptr<Future::Impl> impl(new Future::Impl(*m_requests,	\
+							*m_future_completion)); \
+    std::shared_ptr<Requests::Param> req =				\
+      m_requests->set_param(ParamType,value);				\
+    /* weak, the request already keeps impl as callback */		\
+    std::weak_ptr<Requests::Param> weak_req(req);			\
+    impl->on_success = [this,value,weak_req]()				\
+      {									\
+	std::shared_ptr<Requests::Param> req = weak_req.lock();		\
+	if(req)								\
+	  m_param_cache->changed(*m_requests,req,ParamType,value);	\
+	else								\
+	  m_param_cache->changed(ParamType,value);			\
+	if(!ParamCache::isHeaderParam(ParamType))			\
+	  _config_changed();						\
+      };								\
+    impl->start(req);							\
+    return new Future(impl);						\
+  }
+
+#define EIGER_ASYNC_GET_PARAM(ParamType,ValueType,destination)		\
+  {									\
+    std::shared_ptr<Future::Impl> impl(new Future::Impl(*m_requests,	\
+							*m_future_completion)); \
+    impl->value_type = ValueType;					\
+    impl->start(m_requests->get_param(ParamType,impl->destination));	\
+    return new Future(impl);						\
+  }
+
+static const int STATISTICS_RING_SIZE = 4096;
+static const int RADIAL_PROFILE_RING_SIZE = 1024;
+// compression ratio histogram, the last bin gets all higher ratios
+static const int COMPRESSION_RATIO_NB_BINS = 64;
+static const double COMPRESSION_RATIO_BIN_WIDTH = 0.5;
+
 /*----------------------------------------------------------------------------
 			    Callback class
  ----------------------------------------------------------------------------*/
@@ -102,6 +178,34 @@ private:
   Camera& m_cam;
 };
 
+/** internal trigger requests of the acquisition, the next one is
+ *  pre-built out of startAcq. Only the request is built in advance, the
+ *  connection is the one curl keeps in the cache of its multi handle.
+ */
+class Camera::TriggerSender
+{
+public:
+  TriggerSender(Requests& requests) : m_requests(requests) {}
+
+  void prebuild()
+  {
+    if(!m_prebuilt)
+      m_prebuilt = m_requests.create_command(Requests::TRIGGER);
+  }
+  /** the pre-built trigger, built now if there is none */
+  std::shared_ptr<Requests::Command> take()
+  {
+    std::shared_ptr<Requests::Command> trigger;
+    trigger.swap(m_prebuilt);
+    if(!trigger)
+      trigger = m_requests.create_command(Requests::TRIGGER);
+    return trigger;
+  }
+private:
+  Requests&				m_requests;
+  std::shared_ptr<Requests::Command>	m_prebuilt;
+};
+
 class Camera::InitCallback : public CurlLoop::FutureRequest::Callback
 {	
   DEB_CLASS_NAMESPC(DebModCamera, "Camera", "Eiger::InitCallback");
@@ -125,22 +229,186 @@ private:
   Camera& m_cam;
 };
 
+/*----------------------------------------------------------------------------
+			    Configuration transaction
+ ----------------------------------------------------------------------------*/
+class Camera::ConfigTransaction
+{
+  DEB_CLASS_NAMESPC(DebModCamera, "Camera", "Eiger::ConfigTransaction");
+public:
+  /// a parameter staged twice keeps its last value
+  template<class T>
+  void stage(Requests::PARAM_NAME name,T value)
+  {
+    Staged& staged = m_staged[name];
+    staged.send = [name,value](Requests& requests)
+      {return requests.set_param(name,value);};
+    staged.changed = [name,value](Requests& requests,ParamCache& cache,
+				  const std::shared_ptr<Requests::Param>& request)
+      {cache.changed(requests,request,name,value);};
+  }
+  void stage(Requests::PARAM_NAME name,const char* value)
+  {
+    stage(name,std::string(value));
+  }
+
+  /** send all staged changes at once and wait for all of them.
+   *  @return the errors, one line per failed parameter
+   */
+  std::string commit(Requests& requests,ParamCache& cache)
+  {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(m_staged.size());
+
+    std::list<std::pair<int,std::shared_ptr<Requests::Param> > > pending;
+    for(std::map<int,Staged>::iterator i = m_staged.begin();i != m_staged.end();++i)
+      pending.push_back(std::make_pair(i->first,i->second.send(requests)));
+
+    std::ostringstream errors;
+    for(std::list<std::pair<int,std::shared_ptr<Requests::Param> > >::iterator
+	  i = pending.begin();i != pending.end();++i)
+      {
+	try
+	  {
+	    i->second->wait();
+	    m_staged[i->first].changed(requests,cache,i->second);
+	  }
+	catch(const eigerapi::EigerException &e)
+	  {
+	    requests.cancel(i->second);
+	    errors << "Parameter " << Requests::param_name(Requests::PARAM_NAME(i->first))
+		   << ": " << e.what() << std::endl;
+	  }
+      }
+    return errors.str();
+  }
+  bool isStaged(Requests::PARAM_NAME name) const
+  {
+    return m_staged.count(name);
+  }
+private:
+  struct Staged
+  {
+    std::function<std::shared_ptr<Requests::Param>(Requests&)>	send;
+    std::function<void(Requests&,ParamCache&,
+		       const std::shared_ptr<Requests::Param>&)>	changed;
+  };
+  std::map<int,Staged>	m_staged;
+};
+
+/// Lima trigger mode of the detector trigger mode name and number of triggers
+static bool _trig_mode(const std::string& trig_name,unsigned nb_trigger,TrigMode& trig_mode)
+{
+  if(trig_name == "ints")
+    trig_mode = nb_trigger > 1 ? IntTrigMult : IntTrig;
+  else if(trig_name == "exts")
+    trig_mode = nb_trigger > 1 ? ExtTrigMult : ExtTrigSingle;
+  else if(trig_name == "exte")
+    trig_mode = ExtGate;
+  else
+    return false;
+  return true;
+}
+
 //-----------------------------------------------------------------------------
 ///  Ctor
 //-----------------------------------------------------------------------------
-Camera::Camera(const std::string& detector_ip)	///< [in] Ip address of the detector server
+Camera::Camera(const std::string& detector_ip,	///< [in] Ip address of the detector server
+	       const std::string& startup_cache_dir) ///< [in] startup cache directory, "" no cache
   : 		m_image_number(0),
                 m_latency_time(0.),
                 m_detectorImageType(Bpp16),
 		m_initilize_state(IDLE),
 		m_trigger_state(IDLE),
 		m_serie_id(0),
-                m_requests(new Requests(detector_ip)),
+                m_requests(NULL),
                 m_exp_time(1.),
-		m_detector_ip(detector_ip)
+		m_detector_ip(detector_ip),
+		m_compressed_history_memory(0),
+		m_software_pixel_mask(false),
+		m_statistics_active(false),
+		m_statistics(new FrameRing<FrameStatistics>(STATISTICS_RING_SIZE)),
+		m_software_summation(1),
+		m_sparse_threshold(0.),
+		m_variable_frame_shape(false),
+		m_azimuthal_nb_bins(0),
+		m_azimuthal_integrator(new AzimuthalIntegrator(RADIAL_PROFILE_RING_SIZE)),
+		m_spot_finder(new SpotFinder()),
+		m_nb_peaks(new FrameRing<int>(STATISTICS_RING_SIZE)),
+		m_nb_vetoed_frames(0),
+		m_adaptive_image_type(false),
+		m_bit_depth_readout(32),
+		m_saturated_pixel_value(-1),
+		m_recompression_active(false),
+		m_recompression_type(LZ4),
+		m_recompression_nb_threads(4),
+		m_recompress(new Recompress()),
+		m_compression_histogram(COMPRESSION_RATIO_NB_BINS,0),
+		m_compressed_sizes(new FrameRing<int>(STATISTICS_RING_SIZE)),
+		m_decompression_placement(PROCESSLIB),
+		m_decompression_nb_threads(4),
+		m_decompression_cpu_mask(0),
+		m_param_cache(new ParamCache()),
+		m_config_transaction(NULL),
+		m_nb_images_per_trigger(1),
+		m_nb_triggers_per_arm(1),
+		m_armed_nb_triggers_left(0),
+		m_armed_frame_offset(0),
+		m_config_dirty(false),
+		m_pixel_mask_changed(false),
+		m_future_completion(new FutureCompletion()),
+		m_health_monitor(NULL),
+		m_startup_cache(NULL),
+		m_startup_running(false),
+		m_startup_thread_started(false),
+		m_pipelined_triggers(false),
+		m_nb_triggers_in_flight(0),
+		m_trigger_sender(NULL),
+		m_trigger_timestamp(0.),
+		m_trigger_pending(false)
 {
     DEB_CONSTRUCTOR();
-    DEB_PARAM() << DEB_VAR1(detector_ip);
+    DEB_PARAM() << DEB_VAR2(detector_ip,startup_cache_dir);
+
+    StartupCache::Values cached;
+    if(!startup_cache_dir.empty())
+      m_startup_cache = new StartupCache(startup_cache_dir,detector_ip);
+    if(m_startup_cache && m_startup_cache->load(cached))
+      {
+	// no request here, the startup thread checks the cache and
+	// does the usual initialisation, the camera is Initialising until then
+	m_requests = new Requests(detector_ip,cached.api_version);
+	m_trigger_sender = new TriggerSender(*m_requests);
+	m_health_monitor = new HealthMonitor(*this,*m_requests);
+	m_detector_type = cached.detector_number;
+	m_detector_model = cached.description;
+	m_x_pixelsize = cached.x_pixel_size;
+	m_y_pixelsize = cached.y_pixel_size;
+	m_maxImageWidth = cached.width;
+	m_maxImageHeight = cached.height;
+	m_readout_time = cached.readout_time;
+	m_min_frame_time = cached.min_frame_time;
+	m_bit_depth_readout = cached.bit_depth_readout;
+	m_detectorImageType = cached.auto_summation ? Bpp32 : Bpp16;
+	m_param_cache->set(Requests::DETECTOR_WITDH,m_maxImageWidth);
+	m_param_cache->set(Requests::DETECTOR_HEIGHT,m_maxImageHeight);
+	m_param_cache->set(Requests::AUTO_SUMMATION,cached.auto_summation);
+	m_trig_mode = IntTrig;
+	m_nb_frames = 1;
+
+	// locked, _wait_startup must see m_startup_thread set
+	AutoMutex lock(m_cond.mutex());
+	m_initilize_state = RUNNING;
+	m_startup_running = true;
+	if(pthread_create(&m_startup_thread,NULL,_startupFunc,this))
+	  THROW_HW_ERROR(Error) << "Can't start the startup thread";
+	m_startup_thread_started = true;
+	return;
+      }
+
+    m_requests = new Requests(detector_ip);
+    m_trigger_sender = new TriggerSender(*m_requests);
+    m_health_monitor = new HealthMonitor(*this,*m_requests);
     // Init EigerAPI
     try
       {
@@ -163,6 +431,8 @@ Camera::Camera(const std::string& detector_ip)	///< [in] Ip address of the detec
 
     m_nb_frames = 1;
 
+    if(m_startup_cache)
+      _save_startup_cache();
 }
 
 
@@ -172,7 +442,23 @@ Camera::Camera(const std::string& detector_ip)	///< [in] Ip address of the detec
 Camera::~Camera()
 {
     DEB_DESTRUCTOR();
+    if(m_startup_thread_started)
+      pthread_join(m_startup_thread,NULL);
+    // completions use the requests and the parameter cache
+    m_future_completion->stop();
+    delete m_startup_cache;
+    delete m_health_monitor;
+    delete m_trigger_sender;
     delete m_requests;
+    delete m_statistics;
+    delete m_azimuthal_integrator;
+    delete m_spot_finder;
+    delete m_nb_peaks;
+    delete m_recompress;
+    delete m_compressed_sizes;
+    delete m_config_transaction;
+    delete m_param_cache;
+    delete m_future_completion;
 }
 
 
@@ -182,7 +468,10 @@ Camera::~Camera()
 void Camera::initialize()
 {
   DEB_MEMBER_FUNCT();
+  _wait_startup();
   // Finally initialize the detector
+  // the detector configuration is reloaded
+  m_param_cache->invalidate();
   AutoMutex lock(m_cond.mutex());
   m_initilize_state = RUNNING;
   std::shared_ptr<Requests::Command> async_initialise =
@@ -198,10 +487,15 @@ void Camera::initialize()
 void Camera::prepareAcq()
 {
   DEB_MEMBER_FUNCT();
+  _wait_startup();
+  {
+    AutoMutex config_lock(m_config_mutex);
+    if(m_config_transaction)
+      THROW_HW_ERROR(Error) << "Configuration transaction not committed";
+  }
   AutoMutex aLock(m_cond.mutex());
-  if(m_trigger_state != IDLE)
-    EIGER_SYNC_CMD(Requests::DISARM);
-  
+  // a trigger without frame (stopAcq) doesn't count
+  m_trigger_pending = false;
   int nb_frames;
   unsigned nb_trigger;
   switch(m_trig_mode)
@@ -211,11 +505,25 @@ void Camera::prepareAcq()
       nb_frames = m_nb_frames,nb_trigger = 1;break;
     case IntTrigMult:
     case ExtTrigMult:
+      // nimages x ntrigger series, m_nb_frames is the total
+      if(m_nb_frames % m_nb_images_per_trigger)
+	THROW_HW_ERROR(InvalidValue) << "Number of frames (" << m_nb_frames
+				     << ") is not a multiple of the number of images per trigger ("
+				     << m_nb_images_per_trigger << ")";
+      nb_frames = m_nb_images_per_trigger;
+      nb_trigger = m_nb_frames / m_nb_images_per_trigger;break;
     case ExtGate:
+      if(m_nb_images_per_trigger != 1)
+	THROW_HW_ERROR(NotSupported) << "Several images per gate not supported";
       nb_frames = 1,nb_trigger = m_nb_frames;break;
     default:
       THROW_HW_ERROR(Error) << "Very weird can't be in this case";
     }
+  // the stream sums m_software_summation detector frames into one Lima frame
+  nb_frames *= m_software_summation;
+  // internal single triggers can be re-triggered in the same series
+  if(m_trig_mode == IntTrig)
+    nb_trigger = m_nb_triggers_per_arm;
   double frame_time = m_exp_time + m_latency_time;
   if(frame_time < m_min_frame_time)
     {    
@@ -225,24 +533,88 @@ void Camera::prepareAcq()
 	THROW_HW_ERROR(Error) << "This detector can't go at this frame rate (" << 1 / frame_time
 			      << ") is limited to (" << 1 / m_min_frame_time << ")";
     }
-  DEB_PARAM() << DEB_VAR1(frame_time);
-  std::shared_ptr<Requests::Param> frame_time_req=
-    m_requests->set_param(Requests::FRAME_TIME,frame_time);
-  std::shared_ptr<Requests::Param> nimages_req =
-    m_requests->set_param(Requests::NIMAGES,nb_frames);
-  std::shared_ptr<Requests::Param> ntrigger_req =
-    m_requests->set_param(Requests::NTRIGGER,nb_trigger);
+  DEB_PARAM() << DEB_VAR3(frame_time,nb_frames,nb_trigger);
+
+  Roi full_frame(Point(0,0),Size(m_maxImageWidth,m_maxImageHeight));
+  if(m_software_roi.isActive() && !full_frame.containsRoi(m_software_roi))
+    THROW_HW_ERROR(InvalidValue) << "Software roi " << m_software_roi
+				 << " is outside the detector " << DEB_VAR1(full_frame);
+  if(m_azimuthal_nb_bins > 0)
+    _prepare_azimuthal_integration();
+
+  bool armed = m_armed_nb_triggers_left > 0;
+  if(m_config_dirty.exchange(false))
+    m_armed_nb_triggers_left = 0;
+  // same configuration and triggers left in the armed series: no new arm
+  if(m_trig_mode == IntTrig &&
+     m_armed_nb_triggers_left > 0 && m_trigger_state == IDLE &&
+     m_armed_frame_time == frame_time && m_armed_nb_frames == nb_frames &&
+     m_armed_nb_trigger == nb_trigger)
+    {
+      m_armed_frame_offset = (nb_trigger - m_armed_nb_triggers_left) * nb_frames;
+      DEB_TRACE() << "Reuse armed series " << m_serie_id << ", "
+		  << DEB_VAR1(m_armed_frame_offset);
+      m_image_number = 0;
+      _prepare_raw_dump();
+      _prebuild_trigger();
+      return;
+    }
+
+  if(m_trigger_state != IDLE || armed)
+    EIGER_SYNC_CMD(Requests::DISARM);
+  m_armed_nb_triggers_left = 0;
+  m_armed_frame_offset = 0;
+
+  // only send what changed since the last acquisition
+  std::list<std::shared_ptr<Requests::Param> > pending;
+  std::shared_ptr<Requests::Param> frame_time_req,nb_frames_req,nb_trigger_req;
+  double prev_frame_time;
+  if(!m_param_cache->get(Requests::FRAME_TIME,prev_frame_time) ||
+     prev_frame_time != frame_time)
+    {
+      frame_time_req = m_requests->set_param(Requests::FRAME_TIME,frame_time);
+      pending.push_back(frame_time_req);
+    }
+  int prev_nb_frames;
+  if(!m_param_cache->get(Requests::NIMAGES,prev_nb_frames) ||
+     prev_nb_frames != nb_frames)
+    {
+      nb_frames_req = m_requests->set_param(Requests::NIMAGES,nb_frames);
+      pending.push_back(nb_frames_req);
+    }
+  unsigned prev_nb_trigger;
+  if(!m_param_cache->get(Requests::NTRIGGER,prev_nb_trigger) ||
+     prev_nb_trigger != nb_trigger)
+    {
+      nb_trigger_req = m_requests->set_param(Requests::NTRIGGER,nb_trigger);
+      pending.push_back(nb_trigger_req);
+    }
 
   try
     {
-      frame_time_req->wait();
-      nimages_req->wait();
-      ntrigger_req->wait();
+      for(std::list<std::shared_ptr<Requests::Param> >::iterator i = pending.begin();
+	  i != pending.end();++i)
+	(*i)->wait();
     }
   catch(const eigerapi::EigerException &e)
     {
+      for(std::list<std::shared_ptr<Requests::Param> >::iterator i = pending.begin();
+	  i != pending.end();++i)
+	m_requests->cancel(*i);
+      m_param_cache->invalidate();
       HANDLE_EIGERERROR(e.what());
     }
+  // the detector may list side effects (count_time with frame_time),
+  // without list these are assumed to change nothing else
+  if(frame_time_req)
+    m_param_cache->refreshChanged(*m_requests,frame_time_req,Requests::FRAME_TIME);
+  if(nb_frames_req)
+    m_param_cache->refreshChanged(*m_requests,nb_frames_req,Requests::NIMAGES);
+  if(nb_trigger_req)
+    m_param_cache->refreshChanged(*m_requests,nb_trigger_req,Requests::NTRIGGER);
+  m_param_cache->set(Requests::FRAME_TIME,frame_time);
+  m_param_cache->set(Requests::NIMAGES,nb_frames);
+  m_param_cache->set(Requests::NTRIGGER,nb_trigger);
 
   DEB_TRACE() << "Arm start";
   double timeout = 5 * 60.; // 5 min timeout
@@ -259,7 +631,15 @@ void Camera::prepareAcq()
       m_requests->cancel(arm_cmd);
       HANDLE_EIGERERROR(e.what());
     }
+  m_armed_frame_time = frame_time;
+  m_armed_nb_frames = nb_frames;
+  m_armed_nb_trigger = nb_trigger;
+  // internal triggers are counted, the others use the whole series
+  m_armed_nb_triggers_left = (m_trig_mode == IntTrig || m_trig_mode == IntTrigMult) ?
+    nb_trigger : 1;
   m_image_number = 0;
+  _prepare_raw_dump();
+  _prebuild_trigger();
 }
 
 
@@ -270,22 +650,54 @@ void Camera::startAcq()
 {
   DEB_MEMBER_FUNCT();
   AutoMutex lock(m_cond.mutex());
+  // external triggers consume the armed series
+  if(m_trig_mode != IntTrig && m_trig_mode != IntTrigMult)
+    m_armed_nb_triggers_left = 0;
 
 
   if(m_trig_mode == IntTrig ||
      m_trig_mode == IntTrigMult)
     {
-      std::shared_ptr<Requests::Command> trigger =
-	m_requests->get_command(Requests::TRIGGER);
-      m_trigger_state = RUNNING;
-      lock.unlock();
-
-      std::shared_ptr<CurlLoop::FutureRequest::Callback> cbk(new AcqCallback(*this));
-      trigger->register_callback(cbk);
+      // each IntTrigMult trigger of the series takes nb images per trigger
+      if(m_trig_mode == IntTrigMult && !m_armed_nb_triggers_left)
+	THROW_HW_ERROR(Error) << "No trigger left in the armed series";
+      if(m_armed_nb_triggers_left > 0)
+	--m_armed_nb_triggers_left;
+      // pipelined triggers are sent at once, while the previous ones of
+      // the series are still running
+      if(m_trigger_state == ERROR && m_nb_triggers_in_flight > 0)
+	THROW_HW_ERROR(Error) << "A trigger of the series failed";
+      _send_trigger(lock);
     }
   
 }
 
+/*----------------------------------------------------------------------------
+	send the pre-built trigger, called with m_cond locked, unlocks it.
+	Only called by startAcq, never by the curl loop thread
+  ----------------------------------------------------------------------------*/
+void Camera::_send_trigger(AutoMutex& lock)
+{
+  DEB_MEMBER_FUNCT();
+  std::shared_ptr<Requests::Command> trigger = m_trigger_sender->take();
+  m_trigger_state = RUNNING;
+  // the next frame belongs to a previous trigger if one is still running
+  if(!m_nb_triggers_in_flight++)
+    {
+      m_trigger_timestamp = Timestamp::now();
+      m_trigger_pending.store(true,std::memory_order_release);
+    }
+  DEB_TRACE() << DEB_VAR1(m_nb_triggers_in_flight);
+  m_requests->submit(trigger);
+  // the next startAcq of IntTrigMult sends the next trigger of the series
+  if(m_trig_mode == IntTrigMult)
+    _prebuild_trigger();
+  lock.unlock();
+
+  std::shared_ptr<CurlLoop::FutureRequest::Callback> cbk(new AcqCallback(*this));
+  trigger->register_callback(cbk);
+}
+
 
 //-----------------------------------------------------------------------------
 /// stop the acquisition
@@ -293,6 +705,7 @@ void Camera::startAcq()
 void Camera::stopAcq()
 {
   DEB_MEMBER_FUNCT();
+  _config_changed();
   EIGER_SYNC_CMD(Requests::ABORT);
 }
 
@@ -303,7 +716,11 @@ void Camera::stopAcq()
 void Camera::getDetectorMaxImageSize(Size& size) ///< [out] image dimensions
 {
 	DEB_MEMBER_FUNCT();
-	size = Size(m_maxImageWidth, m_maxImageHeight);
+	AutoMutex lock(m_cond.mutex());
+	if(m_software_roi.isActive())
+	  size = m_software_roi.getSize();
+	else
+	  size = Size(m_maxImageWidth, m_maxImageHeight);
 }
 
 
@@ -314,14 +731,10 @@ void Camera::getDetectorImageSize(Size& size) ///< [out] image dimensions
 {
   DEB_MEMBER_FUNCT();
 
-  std::shared_ptr<Requests::Param> width_request = 
-    m_requests->get_param(Requests::DETECTOR_WITDH);
-  std::shared_ptr<Requests::Param> height_request = 
-    m_requests->get_param(Requests::DETECTOR_HEIGHT);
-
-  Requests::Param::Value width = width_request->get();
-  Requests::Param::Value height = height_request->get();
-  size = Size(width.data.int_val, height.data.int_val);
+  unsigned int width,height;
+  EIGER_CACHED_GET_PARAM(Requests::DETECTOR_WITDH,width);
+  EIGER_CACHED_GET_PARAM(Requests::DETECTOR_HEIGHT,height);
+  size = Size(width,height);
 }
 
 
@@ -332,7 +745,14 @@ void Camera::getImageType(ImageType& type) ///< [out] image type
 {
     DEB_MEMBER_FUNCT();
 
-    type = m_detectorImageType;    
+    {
+      AutoMutex lock(m_cond.mutex());
+      type = m_software_summation > 1 ? Bpp32 : m_detectorImageType;
+    }
+    // auto summation frames are narrowed while decompressing if they can't overflow
+    if(type == Bpp32 && m_software_summation == 1 &&
+       m_adaptive_image_type && _summation_fits_16_bits())
+      type = Bpp16;
 }
 
 
@@ -416,6 +836,7 @@ void Camera::setTrigMode(TrigMode trig_mode) ///< [in] lima trigger mode to set
     }
   
   EIGER_SYNC_SET_PARAM(Requests::TRIGGER_MODE,trig_name);
+  AutoMutex lock(m_cond.mutex());
   m_trig_mode = trig_mode;
 }
 
@@ -426,6 +847,7 @@ void Camera::setTrigMode(TrigMode trig_mode) ///< [in] lima trigger mode to set
 void Camera::getTrigMode(TrigMode& mode) ///< [out] current trigger mode
 {
   DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_cond.mutex());
   mode = m_trig_mode;
 
   DEB_RETURN() << DEB_VAR1(mode);
@@ -440,8 +862,21 @@ void Camera::setExpTime(double exp_time) ///< [in] exposure time to set
   DEB_MEMBER_FUNCT();
   DEB_PARAM() << DEB_VAR1(exp_time);
 
+  ImageType prev_image_type;
+  getImageType(prev_image_type);
+
   EIGER_SYNC_SET_PARAM(Requests::EXPOSURE,exp_time);
   m_exp_time = exp_time;
+
+  // with the adaptive image type, the image depth depends on the exposure time
+  ImageType image_type;
+  getImageType(image_type);
+  if(image_type != prev_image_type)
+    {
+      Size image_size;
+      getDetectorMaxImageSize(image_size);
+      maxImageSizeChanged(image_size,image_type);
+    }
 }
 
 
@@ -523,7 +958,10 @@ const
   DEB_MEMBER_FUNCT();
 
     // --- no info on min latency
-  min_lat = m_readout_time;
+  {
+    AutoMutex lock(m_cond.mutex());
+    min_lat = m_readout_time;
+  }
   double min_exp,max_exp;
   getExposureTimeRange(min_exp,max_exp);
   max_lat = max_exp;
@@ -582,7 +1020,10 @@ Camera::Status Camera::getStatus() ///< [out] current camera status
   if(m_initilize_state == ERROR ||
      m_trigger_state == ERROR)
     status = Fault;
-  else if(m_trigger_state == RUNNING)
+  // pipelined triggers: ready to queue the next trigger of the series
+  else if(m_trigger_state == RUNNING &&
+	  !(m_pipelined_triggers && m_trig_mode == IntTrigMult &&
+	    m_armed_nb_triggers_left > 0))
     status = Exposure;
   else if(m_initilize_state == RUNNING)
     status = Initialising;
@@ -599,7 +1040,14 @@ std::string Camera::getCamStatus()
 {
   DEB_MEMBER_FUNCT();
   std::string status;
-  EIGER_SYNC_GET_PARAM(Requests::DETECTOR_STATUS,status);
+  bool aged;
+  if(m_health_monitor->getLastStatus(status,aged))
+    {
+      if(aged)
+	DEB_TRACE() << "Status of the health monitor paused by the acquisition";
+    }
+  else
+    EIGER_SYNC_GET_PARAM(Requests::DETECTOR_STATUS,status);
   return status;
 }
 //-----------------------------------------------------------------------------
@@ -623,6 +1071,7 @@ void Camera::getPixelSize(double& sizex,	///< [out] horizontal pixel size
 {
   DEB_MEMBER_FUNCT();
 
+  AutoMutex lock(m_cond.mutex());
   sizex = m_x_pixelsize;
   sizey = m_y_pixelsize;
   DEB_RETURN() << DEB_VAR2(sizex, sizey); 
@@ -647,18 +1096,26 @@ void Camera::initialiseController()
 {
   DEB_MEMBER_FUNCT();
   DEB_TRACE() << "initialiseController()";
+  // the detector pixel mask and geometry are read again
+  m_pixel_mask_changed = true;
 
+  // the detector description is read into locals, the startup thread
+  // must not write the members while the getters read them
   std::list<std::shared_ptr<Requests::Param> > synchro_list;
   std::string trig_name;
   synchro_list.push_back(m_requests->get_param(Requests::TRIGGER_MODE,trig_name));
   
-  synchro_list.push_back(m_requests->get_param(Requests::X_PIXEL_SIZE,m_x_pixelsize));
-  synchro_list.push_back(m_requests->get_param(Requests::Y_PIXEL_SIZE,m_y_pixelsize));
+  double x_pixelsize,y_pixelsize;
+  synchro_list.push_back(m_requests->get_param(Requests::X_PIXEL_SIZE,x_pixelsize));
+  synchro_list.push_back(m_requests->get_param(Requests::Y_PIXEL_SIZE,y_pixelsize));
 
-  synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_WITDH,m_maxImageWidth));
-  synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_HEIGHT,m_maxImageHeight));
+  unsigned int width,height;
+  synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_WITDH,width));
+  synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_HEIGHT,height));
 
-  synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_READOUT_TIME,m_readout_time));
+  double readout_time;
+  synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_READOUT_TIME,readout_time));
+  synchro_list.push_back(m_requests->get_param(Requests::PIXELDEPTH,m_bit_depth_readout));
 
   synchro_list.push_back(m_requests->get_param(Requests::DESCRIPTION,m_detector_model));
   synchro_list.push_back(m_requests->get_param(Requests::DETECTOR_NUMBER,m_detector_type));
@@ -673,6 +1130,11 @@ void Camera::initialiseController()
   bool auto_summation;
   synchro_list.push_back(m_requests->get_param(Requests::AUTO_SUMMATION,
 					       auto_summation));
+
+  // parameters only served by the cache, a missing one doesn't fail
+  m_param_cache->invalidate();
+  ParamCache::RequestList cache_list;
+  m_param_cache->prefetch(*m_requests,cache_list);
   
   //Synchro
   try
@@ -690,20 +1152,35 @@ void Camera::initialiseController()
         HANDLE_EIGERERROR(e.what());
     }
 
-  m_detectorImageType = auto_summation ? Bpp32 : Bpp16;
+  m_param_cache->commit(*m_requests,cache_list);
+  m_param_cache->set(Requests::DETECTOR_WITDH,width);
+  m_param_cache->set(Requests::DETECTOR_HEIGHT,height);
+  m_param_cache->set(Requests::AUTO_SUMMATION,auto_summation);
 
   //Trigger mode
-  if(trig_name == "ints")
-    m_trig_mode = nb_trigger > 1 ? IntTrigMult : IntTrig;
-  else if(trig_name == "exts")
-    m_trig_mode = nb_trigger > 1 ? ExtTrigMult : ExtTrigSingle;
-  else if(trig_name == "exte")
-    m_trig_mode = ExtGate;
-  else
+  TrigMode trig_mode;
+  if(!_trig_mode(trig_name,nb_trigger,trig_mode))
     THROW_HW_ERROR(InvalidValue) << "Unexpected trigger mode: " << DEB_VAR1(trig_name);
   
   Requests::Param::Value min_frame_time = frame_time_req->get_min();
+
+  AutoMutex lock(m_cond.mutex());
+  m_x_pixelsize = x_pixelsize;
+  m_y_pixelsize = y_pixelsize;
+  m_maxImageWidth = width;
+  m_maxImageHeight = height;
+  m_readout_time = readout_time;
+  m_detectorImageType = auto_summation ? Bpp32 : Bpp16;
+  m_trig_mode = trig_mode;
   m_min_frame_time = min_frame_time.data.double_val;
+  // the detector geometry may have changed
+  Roi full_frame(Point(0,0),Size(m_maxImageWidth,m_maxImageHeight));
+  if(m_software_roi.isActive() && !full_frame.containsRoi(m_software_roi))
+    {
+      DEB_WARNING() << "Software roi " << m_software_roi << " reset, it's outside the detector "
+		    << DEB_VAR1(full_frame);
+      m_software_roi = Roi();
+    }
  }
 /*----------------------------------------------------------------------------
 	This method is called when the acquisition is finished
@@ -715,13 +1192,20 @@ void Camera::_acquisition_finished(bool ok)
   
   std::string error_msg;
 
-  //First we will disarm
-  if(ok)
+  AutoMutex lock(m_cond.mutex());
+  if(!ok)
+    m_trigger_state = ERROR;
+  // the series goes on while pipelined triggers are running
+  if(--m_nb_triggers_in_flight > 0 || m_trigger_state == ERROR)
+    return;
+  if(m_config_dirty)
+    m_armed_nb_triggers_left = 0;
+  //First we will disarm, but if the armed series can still be re-triggered
+  if(!m_armed_nb_triggers_left)
     std::shared_ptr<Requests::Command> disarm = 
       m_requests->get_command(Requests::DISARM);
 
-  AutoMutex lock(m_cond.mutex());
-  m_trigger_state = ok ? IDLE : ERROR;
+  m_trigger_state = IDLE;
   if(!error_msg.empty())
     DEB_ERROR() << error_msg;
 }
@@ -734,7 +1218,12 @@ void Camera::_acquisition_finished(bool ok)
 void Camera::getTemperature(double &temp)
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::TEMP,temp);
+  HealthSample sample;
+  if(m_health_monitor->getLastSample(sample) &&
+     (!isnan(sample.temperature) || sample.aged))
+    temp = sample.temperature;
+  else
+    EIGER_SYNC_GET_PARAM(Requests::TEMP,temp);
 }
 
 
@@ -747,7 +1236,12 @@ void Camera::getTemperature(double &temp)
 void Camera::getHumidity(double &humidity)
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HUMIDITY,humidity);
+  HealthSample sample;
+  if(m_health_monitor->getLastSample(sample) &&
+     (!isnan(sample.humidity) || sample.aged))
+    humidity = sample.humidity;
+  else
+    EIGER_SYNC_GET_PARAM(Requests::HUMIDITY,humidity);
 }
 
 
@@ -767,7 +1261,7 @@ void Camera::setCountrateCorrection(bool value) ///< [in] true:enabled, false:di
 void Camera::getCountrateCorrection(bool& value)  ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::COUNTRATE_CORRECTION,value);
+  EIGER_CACHED_GET_PARAM(Requests::COUNTRATE_CORRECTION,value);
 }
 
 
@@ -787,7 +1281,7 @@ void Camera::setFlatfieldCorrection(bool value) ///< [in] true:enabled, false:di
 void Camera::getFlatfieldCorrection(bool& value) ///< [out] true:enabled, false:disabled
 {
     DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::FLATFIELD_CORRECTION,value);
+  EIGER_CACHED_GET_PARAM(Requests::FLATFIELD_CORRECTION,value);
 }
 
 //----------------------------------------------------------------------------
@@ -800,9 +1294,11 @@ void Camera::setAutoSummation(bool value)
   EIGER_SYNC_SET_PARAM(Requests::AUTO_SUMMATION,value);
 
   Size image_size;
-  getDetectorImageSize(image_size);
+  getDetectorMaxImageSize(image_size);
   m_detectorImageType = value ? Bpp32 : Bpp16;
-  maxImageSizeChanged(image_size,m_detectorImageType);
+  ImageType image_type;
+  getImageType(image_type);
+  maxImageSizeChanged(image_size,image_type);
 }
 
 //----------------------------------------------------------------------------
@@ -811,7 +1307,7 @@ void Camera::setAutoSummation(bool value)
 void Camera::getAutoSummation(bool& value)
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::AUTO_SUMMATION,value);
+  EIGER_CACHED_GET_PARAM(Requests::AUTO_SUMMATION,value);
   DEB_RETURN() << DEB_VAR1(value);
 }
 //-----------------------------------------------------------------------------
@@ -820,6 +1316,7 @@ void Camera::getAutoSummation(bool& value)
 void Camera::setPixelMask(bool value) ///< [in] true:enabled, false:disabled
 {
     DEB_MEMBER_FUNCT();
+    m_pixel_mask_changed = true;
     EIGER_SYNC_SET_PARAM(Requests::PIXEL_MASK,value);
 }
 
@@ -830,7 +1327,32 @@ void Camera::setPixelMask(bool value) ///< [in] true:enabled, false:disabled
 void Camera::getPixelMask(bool& value) ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::PIXEL_MASK,value);
+  EIGER_CACHED_GET_PARAM(Requests::PIXEL_MASK,value);
+}
+
+//-----------------------------------------------------------------------------
+///  Software PixelMask setter
+/*!
+When enabled, the detector pixel mask is read once from the stream
+header and masked pixels are cleared while frames are decompressed.
+*/
+//-----------------------------------------------------------------------------
+void Camera::setSoftwarePixelMask(bool value) ///< [in] true:enabled, false:disabled
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(value);
+  m_software_pixel_mask = value;
+}
+
+
+//-----------------------------------------------------------------------------
+///  Software PixelMask getter
+//-----------------------------------------------------------------------------
+void Camera::getSoftwarePixelMask(bool& value) const ///< [out] true:enabled, false:disabled
+{
+  DEB_MEMBER_FUNCT();
+  value = m_software_pixel_mask;
+  DEB_RETURN() << DEB_VAR1(value);
 }
 
 //-----------------------------------------------------------------------------
@@ -849,7 +1371,7 @@ void Camera::setEfficiencyCorrection(bool enabled) ///< [in] true:enabled, false
 void Camera::getEfficiencyCorrection(bool& value)  ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::EFFICIENCY_CORRECTION,value);
+  EIGER_CACHED_GET_PARAM(Requests::EFFICIENCY_CORRECTION,value);
 }
 
 
@@ -869,7 +1391,7 @@ void Camera::setThresholdEnergy(double value) ///< [in] true:enabled, false:disa
 void Camera::getThresholdEnergy(double& value) ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::THRESHOLD_ENERGY,value);
+  EIGER_CACHED_GET_PARAM(Requests::THRESHOLD_ENERGY,value);
 }
 
 
@@ -889,7 +1411,7 @@ void Camera::setVirtualPixelCorrection(bool value) ///< [in] true:enabled, false
 void Camera::getVirtualPixelCorrection(bool& value) ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::VIRTUAL_PIXEL_CORRECTION,value);
+  EIGER_CACHED_GET_PARAM(Requests::VIRTUAL_PIXEL_CORRECTION,value);
 }
 
 
@@ -909,7 +1431,7 @@ void Camera::setPhotonEnergy(double value) ///< [in] true:enabled, false:disable
 void Camera::getPhotonEnergy(double& value) ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::PHOTON_ENERGY,value);
+  EIGER_CACHED_GET_PARAM(Requests::PHOTON_ENERGY,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -928,7 +1450,7 @@ void Camera::setWavelength(double value) ///< [in] true:enabled, false:disabled
 void Camera::getWavelength(double& value) ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_WAVELENGTH,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_WAVELENGTH,value);
 }
 
 
@@ -947,7 +1469,7 @@ void Camera::setBeamCenterX(double value) ///< [in]
 void Camera::getBeamCenterX(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_BEAM_CENTER_X,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_BEAM_CENTER_X,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -965,7 +1487,7 @@ void Camera::setBeamCenterY(double value) ///< [in]
 void Camera::getBeamCenterY(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_BEAM_CENTER_Y,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_BEAM_CENTER_Y,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -983,7 +1505,7 @@ void Camera::setDetectorDistance(double value) ///< [in]
 void Camera::getDetectorDistance(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_DETECTOR_DISTANCE,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_DETECTOR_DISTANCE,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -1001,7 +1523,7 @@ void Camera::setChiIncrement(double value) ///< [in]
 void Camera::getChiIncrement(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_CHI_INCREMENT,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_CHI_INCREMENT,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -1019,7 +1541,7 @@ void Camera::setChiStart(double value) ///< [in]
 void Camera::getChiStart(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_CHI_START,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_CHI_START,value);
 }
 
 
@@ -1038,7 +1560,7 @@ void Camera::setKappaIncrement(double value) ///< [in]
 void Camera::getKappaIncrement(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_KAPPA_INCREMENT,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_KAPPA_INCREMENT,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -1056,7 +1578,7 @@ void Camera::setKappaStart(double value) ///< [in]
 void Camera::getKappaStart(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_KAPPA_START,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_KAPPA_START,value);
 }
 
 
@@ -1075,7 +1597,7 @@ void Camera::setOmegaIncrement(double value) ///< [in]
 void Camera::getOmegaIncrement(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_OMEGA_INCREMENT,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_OMEGA_INCREMENT,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -1093,7 +1615,7 @@ void Camera::setOmegaStart(double value) ///< [in]
 void Camera::getOmegaStart(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_OMEGA_START,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_OMEGA_START,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -1111,7 +1633,7 @@ void Camera::setPhiIncrement(double value) ///< [in]
 void Camera::getPhiIncrement(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_PHI_INCREMENT,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_PHI_INCREMENT,value);
 }
 
 //-----------------------------------------------------------------------------
@@ -1129,7 +1651,109 @@ void Camera::setPhiStart(double value) ///< [in]
 void Camera::getPhiStart(double& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::HEADER_PHI_START,value);
+  EIGER_CACHED_GET_PARAM(Requests::HEADER_PHI_START,value);
+}
+
+//-----------------------------------------------------------------------------
+///  Asynchronous requests
+/*!
+The request is sent at once and the returned future (owned by the caller)
+tells when it's finished. Setters update the parameter cache when they
+succeed, they can't be used in a configuration transaction.
+*/
+//-----------------------------------------------------------------------------
+Future* Camera::getTemperatureAsync()
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_GET_PARAM(Requests::TEMP,Future::Double,value.data.double_val);
+}
+
+Future* Camera::getHumidityAsync()
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_GET_PARAM(Requests::HUMIDITY,Future::Double,value.data.double_val);
+}
+
+Future* Camera::getCamStatusAsync()
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_GET_PARAM(Requests::DETECTOR_STATUS,Future::String,value.string_val);
+}
+
+Future* Camera::setCountrateCorrectionAsync(bool value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::COUNTRATE_CORRECTION,value);
+}
+
+Future* Camera::setFlatfieldCorrectionAsync(bool value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::FLATFIELD_CORRECTION,value);
+}
+
+Future* Camera::setEfficiencyCorrectionAsync(bool value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::EFFICIENCY_CORRECTION,value);
+}
+
+Future* Camera::setPixelMaskAsync(bool value)
+{
+  DEB_MEMBER_FUNCT();
+  m_pixel_mask_changed = true;
+  EIGER_ASYNC_SET_PARAM(Requests::PIXEL_MASK,value);
+}
+
+Future* Camera::setVirtualPixelCorrectionAsync(bool value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::VIRTUAL_PIXEL_CORRECTION,value);
+}
+
+Future* Camera::setThresholdEnergyAsync(double value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::THRESHOLD_ENERGY,value);
+}
+
+Future* Camera::setPhotonEnergyAsync(double value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::PHOTON_ENERGY,value);
+}
+
+Future* Camera::setWavelengthAsync(double value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::HEADER_WAVELENGTH,value);
+}
+
+Future* Camera::setBeamCenterXAsync(double value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::HEADER_BEAM_CENTER_X,value);
+}
+
+Future* Camera::setBeamCenterYAsync(double value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::HEADER_BEAM_CENTER_Y,value);
+}
+
+Future* Camera::setDetectorDistanceAsync(double value)
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_ASYNC_SET_PARAM(Requests::HEADER_DETECTOR_DISTANCE,value);
+}
+
+Future* Camera::disarmAsync()
+{
+  DEB_MEMBER_FUNCT();
+  _config_changed();
+  std::shared_ptr<Future::Impl> impl(new Future::Impl(*m_requests,*m_future_completion));
+  impl->start(m_requests->get_command(Requests::DISARM));
+  return new Future(impl);
 }
 
 //-----------------------------------------------------------------------------
@@ -1147,7 +1771,7 @@ void Camera::getDataCollectionDate(std::string& value) ///< [out]
 void Camera::getSoftwareVersion(std::string& value) ///< [out] 
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::SOFTWARE_VERSION,value);
+  EIGER_CACHED_GET_PARAM(Requests::SOFTWARE_VERSION,value);
 }
             
 //-----------------------------------------------------------------------------
@@ -1155,7 +1779,7 @@ void Camera::getSoftwareVersion(std::string& value) ///< [out]
 void Camera::getCompression(bool& value) ///< [out] true:enabled, false:disabled
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_GET_PARAM(Requests::FILEWRITER_COMPRESSION,value);
+  EIGER_CACHED_GET_PARAM(Requests::FILEWRITER_COMPRESSION,value);
 }
 
 
@@ -1171,7 +1795,7 @@ void Camera::getCompressionType(Camera::CompressionType& type) const
 {
   DEB_MEMBER_FUNCT();
   std::string compression_type;
-  EIGER_SYNC_SET_PARAM(Requests::COMPRESSION_TYPE,compression_type);
+  EIGER_SYNC_GET_PARAM(Requests::COMPRESSION_TYPE,compression_type);
   DEB_RETURN() << DEB_VAR1(compression_type);
   type = compression_type == "lz4" ? LZ4 : BSLZ4;
 }
@@ -1182,23 +1806,1063 @@ void Camera::setCompressionType(Camera::CompressionType type)
   EIGER_SYNC_SET_PARAM(Requests::COMPRESSION_TYPE,
 		       type == LZ4 ? "lz4" : "bslz4");
 }
-void Camera::getSerieId(int& serie_id)
+//-----------------------------------------------------------------------------
+/// Activate the per frame statistics computed during decompression
+//-----------------------------------------------------------------------------
+void Camera::setStatisticsActive(bool active)
 {
   DEB_MEMBER_FUNCT();
-  serie_id = m_serie_id;
-  DEB_RETURN() << DEB_VAR1(serie_id);
+  DEB_PARAM() << DEB_VAR1(active);
+  m_statistics_active = active;
 }
 
-void Camera::deleteMemoryFiles()
+void Camera::getStatisticsActive(bool& active) const
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_CMD(Requests::FILEWRITER_CLEAR);
+  active = m_statistics_active;
+  DEB_RETURN() << DEB_VAR1(active);
 }
 
-void Camera::disarm()
+//-----------------------------------------------------------------------------
+/// Get the statistics of a frame of the current acquisition
+/*!
+Only the last frames are kept, older ones are no more available.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getFrameStatistics(int frame_nb,FrameStatistics& statistics) const
 {
   DEB_MEMBER_FUNCT();
-  EIGER_SYNC_CMD(Requests::DISARM);
+  DEB_PARAM() << DEB_VAR1(frame_nb);
+  if(frame_nb < 0 || !m_statistics->read(frame_nb,statistics))
+    THROW_HW_ERROR(Error) << "Statistics of frame " << frame_nb << " not available";
+}
+
+void Camera::getLastFrameStatistics(FrameStatistics& statistics) const
+{
+  DEB_MEMBER_FUNCT();
+  getFrameStatistics(m_statistics->lastFrame(),statistics);
+}
+
+//-----------------------------------------------------------------------------
+/// Memory budget (in MB) of the compressed frame history kept by the stream
+/*!
+When not null, the Lima buffers hold the compressed stream messages:
+Lima gets as many buffers as compressed frames fit into this memory,
+only the last 16 frames are held decompressed and older frames are
+decompressed on demand from their compressed stream message.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getCompressedHistoryMemory(int& nb_mega_bytes) const
+{
+  DEB_MEMBER_FUNCT();
+  nb_mega_bytes = m_compressed_history_memory;
+  DEB_RETURN() << DEB_VAR1(nb_mega_bytes);
+}
+
+void Camera::setCompressedHistoryMemory(int nb_mega_bytes)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_mega_bytes);
+  if(nb_mega_bytes < 0)
+    THROW_HW_ERROR(InvalidValue) << "Memory size must be positive";
+  m_compressed_history_memory = nb_mega_bytes;
+}
+
+//-----------------------------------------------------------------------------
+/// Number of detector frames summed by the stream into one Lima frame
+/*!
+The detector acquires nb_frames * nb_summed_frames images, the sum is done
+in 32 bits (saturated) while decompressing. 1 means no summation.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getSoftwareSummation(int& nb_summed_frames) const
+{
+  DEB_MEMBER_FUNCT();
+  nb_summed_frames = m_software_summation;
+  DEB_RETURN() << DEB_VAR1(nb_summed_frames);
+}
+
+void Camera::setSoftwareSummation(int nb_summed_frames)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_summed_frames);
+  if(nb_summed_frames < 1)
+    THROW_HW_ERROR(InvalidValue) << "Number of summed frames must be >= 1";
+  m_software_summation = nb_summed_frames;
+
+  Size image_size;
+  getDetectorMaxImageSize(image_size);
+  ImageType image_type;
+  getImageType(image_type);
+  maxImageSizeChanged(image_size,image_type);
+}
+
+//-----------------------------------------------------------------------------
+/// Region of the detector frame kept by the stream decompression
+/*!
+Lima buffers are allocated with the roi size, the rest of the frame
+is dropped while decompressing. An empty roi means the full frame.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getSoftwareRoi(Roi& roi) const
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_cond.mutex());
+  roi = m_software_roi;
+  DEB_RETURN() << DEB_VAR1(roi);
+}
+
+void Camera::setSoftwareRoi(const Roi& roi)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(roi);
+  {
+    AutoMutex lock(m_cond.mutex());
+    Roi full_frame(Point(0,0),Size(m_maxImageWidth,m_maxImageHeight));
+    if(roi.isActive() && !full_frame.containsRoi(roi))
+      THROW_HW_ERROR(InvalidValue) << "Roi " << roi << " is outside the detector "
+				   << DEB_VAR1(full_frame);
+    m_software_roi = roi;
+  }
+
+  Size image_size;
+  getDetectorMaxImageSize(image_size);
+  ImageType image_type;
+  getImageType(image_type);
+  maxImageSizeChanged(image_size,image_type);
+}
+
+//-----------------------------------------------------------------------------
+/// Occupancy threshold of the sparse frame output
+/*!
+When a decompressed frame has a fraction of non-zero pixels lower or
+equal to this threshold, it is replaced by a list of (pixel index,value).
+0 disables the sparse output.
+Sparse frames change shape from frame to frame, Lima saving can't store
+them: they need setVariableFrameShape(true).
+*/
+//-----------------------------------------------------------------------------
+void Camera::getSparseThreshold(double& occupancy) const
+{
+  DEB_MEMBER_FUNCT();
+  occupancy = m_sparse_threshold;
+  DEB_RETURN() << DEB_VAR1(occupancy);
+}
+
+void Camera::setSparseThreshold(double occupancy)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(occupancy);
+  if(occupancy < 0. || occupancy > 1.)
+    THROW_HW_ERROR(InvalidValue) << "Occupancy must be between 0 and 1";
+  m_sparse_threshold = occupancy;
+}
+
+//-----------------------------------------------------------------------------
+/// Allow frames which shape changes within an acquisition
+/*!
+Lima saving needs frames of the size and type of the Lima buffers.
+Outputs replacing the frame by something else (sparse frames, recompressed
+chunks) are refused
+at prepareAcq unless this is set, which says Lima saving is off and frames
+only go to online consumers.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getVariableFrameShape(bool& variable) const
+{
+  DEB_MEMBER_FUNCT();
+  variable = m_variable_frame_shape;
+  DEB_RETURN() << DEB_VAR1(variable);
+}
+
+void Camera::setVariableFrameShape(bool variable)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(variable);
+  m_variable_frame_shape = variable;
+}
+
+//-----------------------------------------------------------------------------
+/// Number of q bins of the radial profile computed on each frame
+/*!
+The pixel to bin table is built at prepareAcq from the beam center,
+detector distance, wavelength and pixel size. 0 disables the integration.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getAzimuthalIntegration(int& nb_bins) const
+{
+  DEB_MEMBER_FUNCT();
+  nb_bins = m_azimuthal_nb_bins;
+  DEB_RETURN() << DEB_VAR1(nb_bins);
+}
+
+void Camera::setAzimuthalIntegration(int nb_bins)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_bins);
+  if(nb_bins < 0)
+    THROW_HW_ERROR(InvalidValue) << "Number of bins must be positive";
+  m_azimuthal_nb_bins = nb_bins;
+}
+
+/// q (1/Angstrom) of the bin centers of the radial profiles
+void Camera::getRadialAxis(std::vector<double>& q) const
+{
+  DEB_MEMBER_FUNCT();
+  m_azimuthal_integrator->getRadialAxis(q);
+}
+
+void Camera::getRadialProfile(int frame_nb,std::vector<double>& profile) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(frame_nb);
+  if(!m_azimuthal_integrator->getProfile(frame_nb,profile))
+    THROW_HW_ERROR(Error) << "Radial profile of frame " << frame_nb << " not available";
+}
+
+void Camera::getLastRadialProfile(std::vector<double>& profile) const
+{
+  DEB_MEMBER_FUNCT();
+  getRadialProfile(m_azimuthal_integrator->lastFrame(),profile);
+}
+
+//-----------------------------------------------------------------------------
+/// Bragg spot finding done on each decompressed frame
+/*!
+The number of peaks is added to the frame header (nb_peaks, hit).
+With veto, frames with less than hit_threshold peaks are dropped by
+the stream thread (RECEIVE_THREAD decompression placement) and never
+reach Lima: the kept frames are numbered consecutively and the Lima
+acquisition gets less frames than requested, stop it with stopAcq once
+the camera is Ready. getNbVetoedFrames returns the number of dropped frames.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getSpotFinding(SpotFindingParameters& parameters) const
+{
+  DEB_MEMBER_FUNCT();
+  parameters = m_spot_finding;
+}
+
+void Camera::setSpotFinding(const SpotFindingParameters& parameters)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR4(parameters.active,parameters.half_box_size,
+			  parameters.sigma_threshold,parameters.veto);
+  if(parameters.half_box_size < 1 || parameters.min_pixels < 1 ||
+     parameters.sigma_threshold < 0.)
+    THROW_HW_ERROR(InvalidValue) << "Wrong spot finding parameters";
+  m_spot_finding = parameters;
+}
+
+void Camera::getFrameNbPeaks(int frame_nb,int& nb_peaks) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(frame_nb);
+  if(frame_nb < 0 || !m_nb_peaks->read(frame_nb,nb_peaks))
+    THROW_HW_ERROR(Error) << "Number of peaks of frame " << frame_nb << " not available";
+  DEB_RETURN() << DEB_VAR1(nb_peaks);
+}
+
+void Camera::getLastFrameNbPeaks(int& nb_peaks) const
+{
+  DEB_MEMBER_FUNCT();
+  getFrameNbPeaks(m_nb_peaks->lastFrame(),nb_peaks);
+}
+
+void Camera::getNbVetoedFrames(int& nb_frames) const
+{
+  DEB_MEMBER_FUNCT();
+  nb_frames = m_nb_vetoed_frames;
+  DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------------------------------
+/// Narrow auto summation frames to 16 bits when they can't overflow
+/*!
+With auto summation the detector sends 32 bits frames, the sum of
+internal frames of bit_depth_readout bits, each one at least the
+minimum frame time long. If the exposure time is short enough for the
+sum to stay below 0xffff, Lima buffers are 16 bits and frames are
+narrowed while decompressing. 0xffff stays the saturation marker: the
+detector saturated pixels and any pixel above 0xfffe are set to it.
+Longer exposures (or software summation) fall back to 32 bits.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getAdaptiveImageType(bool& active) const
+{
+  DEB_MEMBER_FUNCT();
+  active = m_adaptive_image_type;
+  DEB_RETURN() << DEB_VAR1(active);
+}
+
+void Camera::setAdaptiveImageType(bool active)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(active);
+  m_adaptive_image_type = active;
+
+  Size image_size;
+  getDetectorMaxImageSize(image_size);
+  ImageType image_type;
+  getImageType(image_type);
+  maxImageSizeChanged(image_size,image_type);
+}
+
+//-----------------------------------------------------------------------------
+/// Value of the saturated and invalid pixels of 32 bits frames
+/*!
+All 32 bits frames (16 bits frames widened, 32 bits detector frames and
+summed frames) get this value for their saturated and invalid pixels.
+The value is cast to 32 bits unsigned, the default -1 gives 0xffffffff,
+the all-ones value the detector uses in its own 32 bits frames.
+16 bits frames keep 0xffff.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getSaturatedPixelValue(int& value) const
+{
+  DEB_MEMBER_FUNCT();
+  value = m_saturated_pixel_value;
+  DEB_RETURN() << DEB_VAR1(value);
+}
+
+void Camera::setSaturatedPixelValue(int value)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(value);
+  m_saturated_pixel_value = value;
+}
+
+//-----------------------------------------------------------------------------
+/// Recompression of the frames into hdf5 filter chunks
+/*!
+Frames are sent to Lima as UINT8 frames of chunk bytes (lz4 filter or
+bitshuffle lz4 filter format), for online consumers doing their own hdf5
+direct chunk write. Lima saving can't store these variable size frames,
+they need setVariableFrameShape(true): Lima compresses the frames in its
+own saving tasks and has no hook to write chunks compressed by a camera
+plugin. Slices of the frame are
+compressed by a pool of nb_threads threads. Without any other
+processing, lz4 stream messages are only wrapped in the chunk format.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getRecompression(bool& active) const
+{
+  DEB_MEMBER_FUNCT();
+  active = m_recompression_active;
+  DEB_RETURN() << DEB_VAR1(active);
+}
+
+void Camera::setRecompression(bool active)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(active);
+  m_recompression_active = active;
+}
+
+void Camera::getRecompressionType(CompressionType& type) const
+{
+  DEB_MEMBER_FUNCT();
+  type = m_recompression_type;
+  DEB_RETURN() << DEB_VAR1(type);
+}
+
+void Camera::setRecompressionType(CompressionType type)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(type);
+  if(!Recompress::isSupported(type))
+    THROW_HW_ERROR(NotSupported) << "bslz4 recompression needs the bitshuffle library";
+  m_recompression_type = type;
+}
+
+void Camera::getRecompressionNbThreads(int& nb_threads) const
+{
+  DEB_MEMBER_FUNCT();
+  nb_threads = m_recompression_nb_threads;
+  DEB_RETURN() << DEB_VAR1(nb_threads);
+}
+
+void Camera::setRecompressionNbThreads(int nb_threads)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_threads);
+  if(nb_threads < 1)
+    THROW_HW_ERROR(InvalidValue) << "Number of threads must be >= 1";
+  m_recompression_nb_threads = nb_threads;
+}
+
+//-----------------------------------------------------------------------------
+/// Raw binary dump of the decompressed frames
+/*!
+Frames are decompressed straight into filename_<serie id>, a file of
+nb_frames frames pre-allocated at prepareAcq, and the frame metadata are
+written into filename_<serie id>.index (see RawDump). A re-triggered
+series gets filename_<serie id>_<first frame of the trigger>. An existing
+file is never overwritten, prepareAcq fails instead. Lima buffers are not
+filled with the frame, their content is undefined and the frame header
+has raw_dump=1, Lima saving should be off. An empty filename disables the dump.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getRawDumpFile(std::string& filename) const
+{
+  DEB_MEMBER_FUNCT();
+  filename = m_raw_dump_filename;
+  DEB_RETURN() << DEB_VAR1(filename);
+}
+
+void Camera::setRawDumpFile(const std::string& filename)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(filename);
+  m_raw_dump_filename = filename;
+  if(filename.empty())
+    {
+      AutoMutex lock(m_raw_dump_mutex);
+      m_raw_dump.reset();
+    }
+}
+
+void Camera::_prepare_raw_dump()
+{
+  DEB_MEMBER_FUNCT();
+  std::shared_ptr<RawDump> raw_dump;
+  if(!m_raw_dump_filename.empty())
+    {
+      Size image_size;
+      getDetectorMaxImageSize(image_size);
+      ImageType image_type;
+      getImageType(image_type);
+      // one file per acquisition, a previous one is never overwritten
+      std::ostringstream filename;
+      filename << m_raw_dump_filename << '_' << m_serie_id;
+      if(m_armed_frame_offset)
+	filename << '_' << m_armed_frame_offset;
+      raw_dump.reset(new RawDump(filename.str(),m_nb_frames,
+				 FrameDim(image_size,image_type)));
+    }
+  AutoMutex lock(m_raw_dump_mutex);
+  m_raw_dump = raw_dump;
+}
+
+//-----------------------------------------------------------------------------
+/// Compressed size of the stream frames
+/*!
+Every stream frame (detector frame) adds its compressed size to a running
+mean and to a histogram of the compression ratio (uncompressed / compressed
+size): bin i counts the ratios in [i * 0.5,(i + 1) * 0.5), the last bin
+gets all the higher ratios. Sizes accumulate across acquisitions until
+resetCompressionStatistics(), the compressed size of the last frames of
+the current acquisition is given by getFrameCompressedSize(frame_nb).
+*/
+//-----------------------------------------------------------------------------
+void Camera::getCompressionStatistics(CompressionStatistics& statistics) const
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_compression_mutex);
+  statistics = m_compression_statistics;
+}
+
+void Camera::getCompressionRatioHistogram(std::vector<int>& histogram) const
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_compression_mutex);
+  histogram = m_compression_histogram;
+}
+
+void Camera::getFrameCompressedSize(int frame_nb,int& size) const
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(frame_nb);
+  if(frame_nb < 0 || !m_compressed_sizes->read(frame_nb,size))
+    THROW_HW_ERROR(Error) << "Compressed size of frame " << frame_nb << " not available";
+  DEB_RETURN() << DEB_VAR1(size);
+}
+
+void Camera::resetCompressionStatistics()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_compression_mutex);
+  m_compression_statistics = CompressionStatistics();
+  m_compression_histogram.assign(COMPRESSION_RATIO_NB_BINS,0);
+}
+
+/** called by the stream for each received frame
+ */
+void Camera::_compressed_frame(int frame_nb,size_t compressed_size,int frame_size)
+{
+  if(!compressed_size) return;
+  m_compressed_sizes->write(frame_nb,int(compressed_size));
+
+  double ratio = double(frame_size) / compressed_size;
+  int bin = std::min(int(ratio / COMPRESSION_RATIO_BIN_WIDTH),COMPRESSION_RATIO_NB_BINS - 1);
+  AutoMutex lock(m_compression_mutex);
+  CompressionStatistics& statistics = m_compression_statistics;
+  int nb_frames = ++statistics.nb_frames;
+  statistics.mean_size += (compressed_size - statistics.mean_size) / nb_frames;
+  statistics.mean_ratio += (ratio - statistics.mean_ratio) / nb_frames;
+  if(nb_frames == 1 || ratio < statistics.min_ratio) statistics.min_ratio = ratio;
+  if(ratio > statistics.max_ratio) statistics.max_ratio = ratio;
+  ++m_compression_histogram[bin];
+}
+
+//-----------------------------------------------------------------------------
+/// Where the stream frames are decompressed
+/*!
+- PROCESSLIB: by the reconstruction task, in the processlib pool
+- RECEIVE_THREAD: by the stream thread, before the frame is given to Lima
+- DEDICATED_POOL: by a pool of threads owned by the plugin, optionally
+  pinned on the cpus of cpu_mask (bit i for cpu i, 0 for no pinning),
+  e.g. the cpus near the network card. Frames are given to Lima in
+  order, the acquisition stops with an error event if the pool is more
+  than the number of Lima buffers behind the stream
+
+Outside processlib a frame can't be replaced, so sparse frames and
+recompression need PROCESSLIB. Processlib can't drop a frame, so the
+spot finding veto needs RECEIVE_THREAD.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getDecompressionPlacement(DecompressionPlacement& placement) const
+{
+  DEB_MEMBER_FUNCT();
+  placement = m_decompression_placement;
+  DEB_RETURN() << DEB_VAR1(placement);
+}
+
+void Camera::setDecompressionPlacement(DecompressionPlacement placement)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(placement);
+  m_decompression_placement = placement;
+}
+
+void Camera::getDecompressionPool(int& nb_threads,unsigned long long& cpu_mask) const
+{
+  DEB_MEMBER_FUNCT();
+  nb_threads = m_decompression_nb_threads;
+  cpu_mask = m_decompression_cpu_mask;
+  DEB_RETURN() << DEB_VAR2(nb_threads,cpu_mask);
+}
+
+void Camera::setDecompressionPool(int nb_threads,unsigned long long cpu_mask)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(nb_threads,cpu_mask);
+  if(nb_threads < 1)
+    THROW_HW_ERROR(InvalidValue) << "Number of threads must be >= 1";
+  m_decompression_nb_threads = nb_threads;
+  m_decompression_cpu_mask = cpu_mask;
+}
+
+bool Camera::_summation_fits_16_bits() const
+{
+  DEB_MEMBER_FUNCT();
+  if(m_bit_depth_readout <= 0 || m_bit_depth_readout >= 16 || m_min_frame_time <= 0.)
+    return false;
+  double nb_internal_frames = ceil(m_exp_time / m_min_frame_time);
+  double max_count = nb_internal_frames * ((1 << m_bit_depth_readout) - 1);
+  bool fits = max_count < 0xffff;
+  DEB_RETURN() << DEB_VAR3(nb_internal_frames,max_count,fits);
+  return fits;
+}
+
+void Camera::_prepare_azimuthal_integration()
+{
+  DEB_MEMBER_FUNCT();
+  AzimuthalIntegrator::Geometry geometry;
+  getDetectorMaxImageSize(geometry.frame_size);
+  if(m_software_roi.isActive())
+    geometry.frame_offset = m_software_roi.getTopLeft();
+  getBeamCenterX(geometry.beam_center_x);
+  getBeamCenterY(geometry.beam_center_y);
+  getDetectorDistance(geometry.distance);
+  getWavelength(geometry.wavelength);
+  geometry.pixel_size_x = m_x_pixelsize;
+  geometry.pixel_size_y = m_y_pixelsize;
+  geometry.nb_bins = m_azimuthal_nb_bins;
+  m_azimuthal_integrator->setGeometry(geometry);
+}
+
+//-----------------------------------------------------------------------------
+/// Empty the detector parameter cache
+/*!
+Configuration getters are served by a client side cache filled at
+initialisation and updated by the setters. Call this when the detector
+configuration was changed by an other client.
+*/
+//-----------------------------------------------------------------------------
+void Camera::invalidateParamCache()
+{
+  DEB_MEMBER_FUNCT();
+  m_param_cache->invalidate();
+}
+
+//-----------------------------------------------------------------------------
+/// Start a configuration transaction
+/*!
+Until commitConfiguration(), detector parameter setters only stage
+their change, the plugin state (exposure time, trigger mode,...) is
+updated right away. The commit sends all staged changes at once and
+waits for them in a single round trip. Parameters which depend on each
+other on the detector side (photon and threshold energies) should not
+be staged in the same transaction, they are not sent in order.
+*/
+//-----------------------------------------------------------------------------
+void Camera::beginConfiguration()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex config_lock(m_config_mutex);
+  if(m_config_transaction)
+    THROW_HW_ERROR(Error) << "A configuration transaction is already started";
+  m_config_transaction = new ConfigTransaction();
+}
+
+//-----------------------------------------------------------------------------
+/// Send the staged changes
+/*!
+All changes are sent, if some fail the plugin state is read back from
+the detector and one error reports all failed parameters.
+*/
+//-----------------------------------------------------------------------------
+void Camera::commitConfiguration()
+{
+  DEB_MEMBER_FUNCT();
+  _wait_startup();
+  AutoMutex config_lock(m_config_mutex);
+  if(!m_config_transaction)
+    THROW_HW_ERROR(Error) << "No configuration transaction started";
+  std::unique_ptr<ConfigTransaction> transaction(m_config_transaction);
+  m_config_transaction = NULL;
+  config_lock.unlock();
+
+  std::string errors = transaction->commit(*m_requests,*m_param_cache);
+  _config_changed();
+  if(!errors.empty())
+    {
+      _resynchronize(*transaction);
+      THROW_HW_ERROR(Error) << "Configuration failed:\n" << errors;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Drop the staged changes and read back the plugin state from the detector
+//-----------------------------------------------------------------------------
+void Camera::abortConfiguration()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex config_lock(m_config_mutex);
+  if(!m_config_transaction)
+    return;
+  std::unique_ptr<ConfigTransaction> transaction(m_config_transaction);
+  m_config_transaction = NULL;
+  config_lock.unlock();
+
+  _resynchronize(*transaction);
+}
+
+/*----------------------------------------------------------------------------
+	the plugin state updated by the staged setters (trigger mode,
+	exposure time, image type) may differ from the detector one,
+	read it back. Other parameters are only updated in the
+	cache when their set succeeded.
+  ----------------------------------------------------------------------------*/
+void Camera::_resynchronize(const ConfigTransaction& transaction)
+{
+  DEB_MEMBER_FUNCT();
+  std::list<std::shared_ptr<Requests::Param> > synchro_list;
+  bool trigger_mode = transaction.isStaged(Requests::TRIGGER_MODE);
+  std::string trig_name;
+  unsigned nb_trigger;
+  if(trigger_mode)
+    {
+      synchro_list.push_back(m_requests->get_param(Requests::TRIGGER_MODE,trig_name));
+      synchro_list.push_back(m_requests->get_param(Requests::NTRIGGER,nb_trigger));
+    }
+  bool exposure = transaction.isStaged(Requests::EXPOSURE);
+  double exp_time;
+  if(exposure)
+    synchro_list.push_back(m_requests->get_param(Requests::EXPOSURE,exp_time));
+  bool auto_summation_staged = transaction.isStaged(Requests::AUTO_SUMMATION);
+  bool auto_summation;
+  if(auto_summation_staged)
+    synchro_list.push_back(m_requests->get_param(Requests::AUTO_SUMMATION,auto_summation));
+
+  try
+    {
+      for(std::list<shared_ptr<Requests::Param> >::iterator i = synchro_list.begin();
+	  i != synchro_list.end();++i)
+	(*i)->wait();
+    }
+  catch(const eigerapi::EigerException &e)
+    {
+      for(std::list<shared_ptr<Requests::Param> >::iterator i = synchro_list.begin();
+	  i != synchro_list.end();++i)
+	m_requests->cancel(*i);
+
+      HANDLE_EIGERERROR(e.what());
+    }
+
+  if(trigger_mode && !_trig_mode(trig_name,nb_trigger,m_trig_mode))
+    THROW_HW_ERROR(InvalidValue) << "Unexpected trigger mode: " << DEB_VAR1(trig_name);
+  if(exposure)
+    m_exp_time = exp_time;
+  if(auto_summation_staged)
+    {
+      m_param_cache->set(Requests::AUTO_SUMMATION,auto_summation);
+      m_detectorImageType = auto_summation ? Bpp32 : Bpp16;
+    }
+
+  Size image_size;
+  getDetectorMaxImageSize(image_size);
+  ImageType image_type;
+  getImageType(image_type);
+  maxImageSizeChanged(image_size,image_type);
+}
+
+void Camera::getSerieId(int& serie_id)
+{
+  DEB_MEMBER_FUNCT();
+  serie_id = m_serie_id;
+  DEB_RETURN() << DEB_VAR1(serie_id);
+}
+
+void Camera::deleteMemoryFiles()
+{
+  DEB_MEMBER_FUNCT();
+  EIGER_SYNC_CMD(Requests::FILEWRITER_CLEAR);
+}
+
+void Camera::disarm()
+{
+  DEB_MEMBER_FUNCT();
+  _config_changed();
+  EIGER_SYNC_CMD(Requests::DISARM);
+}
+
+//-----------------------------------------------------------------------------
+/// Number of images of each trigger in IntTrigMult and ExtTrigMult
+/*!
+The series is armed for nb images x (nb frames / nb) triggers, so a
+fly-scan of K images per trigger across M triggers is one armed series
+of K x M frames, nb frames must be a multiple of nb. In IntTrigMult each
+startAcq takes nb images. 1 (default) is one image per trigger.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getNbImagesPerTrigger(int& nb) const
+{
+  DEB_MEMBER_FUNCT();
+  nb = m_nb_images_per_trigger;
+  DEB_RETURN() << DEB_VAR1(nb);
+}
+
+void Camera::setNbImagesPerTrigger(int nb)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb);
+  if(nb < 1)
+    THROW_HW_ERROR(InvalidValue) << "Number of images per trigger must be >= 1";
+  AutoMutex lock(m_cond.mutex());
+  m_nb_images_per_trigger = nb;
+}
+
+//-----------------------------------------------------------------------------
+/// Number of internal triggers of an armed series
+/*!
+With IntTrig, the series is armed for nb internal triggers. While the
+configuration doesn't change, the next nb - 1 prepareAcq reuse the armed
+series instead of a disarm/arm cycle. 1 (default) arms every acquisition.
+Detector parameter changes, stopAcq and the detector file writer (new files
+for each acquisition) need a new arm.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getNbTriggersPerArm(int& nb) const
+{
+  DEB_MEMBER_FUNCT();
+  nb = m_nb_triggers_per_arm;
+  DEB_RETURN() << DEB_VAR1(nb);
+}
+
+void Camera::setNbTriggersPerArm(int nb)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb);
+  if(nb < 1)
+    THROW_HW_ERROR(InvalidValue) << "Number of triggers must be >= 1";
+  AutoMutex lock(m_cond.mutex());
+  m_nb_triggers_per_arm = nb;
+}
+
+//-----------------------------------------------------------------------------
+/// Health monitor refresh periods in seconds
+/*!
+While period > 0, a low priority thread refreshes the temperature, humidity
+and detector state every period, every acq_period during acquisitions
+(0 pauses it), and getTemperature, getHumidity and getCamStatus return the
+last refresh instead of doing a request. While paused by an acquisition,
+they return the last refresh, however old, and only request the detector
+if there is none yet (see getLastHealthSample). period = 0 (default)
+stops it.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getHealthMonitorPeriod(double& period,double& acq_period) const
+{
+  DEB_MEMBER_FUNCT();
+  m_health_monitor->getPeriod(period,acq_period);
+  DEB_RETURN() << DEB_VAR2(period,acq_period);
+}
+
+void Camera::setHealthMonitorPeriod(double period,double acq_period)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(period,acq_period);
+  m_health_monitor->setPeriod(period,acq_period);
+}
+
+//-----------------------------------------------------------------------------
+/// last health monitor refreshes, oldest first
+//-----------------------------------------------------------------------------
+void Camera::getHealthHistory(std::vector<HealthSample>& samples) const
+{
+  DEB_MEMBER_FUNCT();
+  m_health_monitor->getHistory(samples);
+}
+
+//-----------------------------------------------------------------------------
+/// last health monitor refresh, aged if the monitor is paused by the acquisition
+/*!
+@return false if the monitor is stopped, has no refresh yet or the
+refresh is too old
+*/
+//-----------------------------------------------------------------------------
+bool Camera::getLastHealthSample(HealthSample& sample) const
+{
+  DEB_MEMBER_FUNCT();
+  return m_health_monitor->getLastSample(sample);
+}
+
+//-----------------------------------------------------------------------------
+/// Pipelined IntTrigMult triggers
+/*!
+The trigger request only returns at the end of the exposure. When
+active, startAcq doesn't wait for it: the camera stays Ready while the
+series takes triggers and each startAcq sends its trigger at once, while
+the previous ones are still running, so the trigger round-trips overlap.
+The series is disarmed when no trigger is running and none is left.
+Header parameters may be set during the series, any other configuration
+change ends it once the running triggers are finished. A failed trigger
+puts the camera in Fault. Default is inactive.
+*/
+//-----------------------------------------------------------------------------
+void Camera::getPipelinedTriggers(bool& active) const
+{
+  DEB_MEMBER_FUNCT();
+  active = m_pipelined_triggers;
+  DEB_RETURN() << DEB_VAR1(active);
+}
+
+void Camera::setPipelinedTriggers(bool active)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(active);
+  AutoMutex lock(m_cond.mutex());
+  m_pipelined_triggers = active;
+}
+
+//-----------------------------------------------------------------------------
+/// Internal trigger to first frame latency
+/*!
+With IntTrig and IntTrigMult, the time from sending the trigger in startAcq
+to the reception of the first following stream frame. It includes the
+count time and the readout of that frame. Latencies accumulate across
+acquisitions until resetTriggerLatency().
+*/
+//-----------------------------------------------------------------------------
+void Camera::getTriggerLatency(TriggerLatency& latency) const
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_trigger_latency_mutex);
+  latency = m_trigger_latency;
+}
+
+void Camera::resetTriggerLatency()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_trigger_latency_mutex);
+  m_trigger_latency = TriggerLatency();
+}
+
+/*----------------------------------------------------------------------------
+	pre-build the next internal trigger request out of startAcq,
+	which then only submits it
+  ----------------------------------------------------------------------------*/
+void Camera::_prebuild_trigger()
+{
+  DEB_MEMBER_FUNCT();
+  if(m_trig_mode == IntTrig || m_trig_mode == IntTrigMult)
+    m_trigger_sender->prebuild();
+}
+
+/** called by the stream for each received frame
+ */
+void Camera::_frame_received(double timestamp)
+{
+  if(!m_trigger_pending.load(std::memory_order_relaxed) ||
+     !m_trigger_pending.exchange(false,std::memory_order_acquire))
+    return;
+
+  double latency = timestamp - m_trigger_timestamp;
+  AutoMutex lock(m_trigger_latency_mutex);
+  TriggerLatency& statistics = m_trigger_latency;
+  int nb_triggers = ++statistics.nb_triggers;
+  statistics.last = latency;
+  statistics.mean += (latency - statistics.mean) / nb_triggers;
+  if(nb_triggers == 1 || latency < statistics.min) statistics.min = latency;
+  if(latency > statistics.max) statistics.max = latency;
+}
+
+/*----------------------------------------------------------------------------
+	the detector configuration changed, the armed series can't be reused
+  ----------------------------------------------------------------------------*/
+void Camera::_config_changed()
+{
+  // no lock, may be called while a request holds m_cond
+  m_config_dirty = true;
+}
+
+/*----------------------------------------------------------------------------
+	Construction from the startup cache: the detector is checked and
+	initialised in the background, the camera is Initialising until then
+  ----------------------------------------------------------------------------*/
+void* Camera::_startupFunc(void* cam)
+{
+  ((Camera*)cam)->_startup();
+  return NULL;
+}
+
+void Camera::_startup()
+{
+  DEB_MEMBER_FUNCT();
+  unsigned int prev_width = m_maxImageWidth;
+  unsigned int prev_height = m_maxImageHeight;
+  ImageType prev_image_type = m_detectorImageType;
+  std::string error_msg;
+  try
+    {
+      // the urls of m_requests were built with the cached api version
+      std::string api_version;
+      std::shared_ptr<Requests::Param> version_req =
+	m_requests->get_detector_api_version(api_version);
+      try
+	{
+	  version_req->wait();
+	}
+      catch(const eigerapi::EigerException &e)
+	{
+	  m_requests->cancel(version_req);
+	  throw;
+	}
+      StartupCache::Values cached;
+      bool cache_loaded = m_startup_cache->load(cached);
+      if(cache_loaded && api_version != cached.api_version)
+	{
+	  m_startup_cache->remove();
+	  THROW_HW_ERROR(Error) << "Detector api version changed from "
+				<< cached.api_version << " to " << api_version
+				<< ", the camera must be created again";
+	}
+
+      try
+	{
+	  initialiseController();
+	}
+      catch(Exception& e)
+	{
+	  DEB_ALWAYS() << "Could not get configuration parameters, try to initialize";
+	  EIGER_SYNC_CMD_TIMEOUT(Requests::INITIALIZE,5*60);
+	  initialiseController();
+	}
+      // another detector or firmware behind the same address: the cached
+      // description is dropped, the values just read replace it
+      std::string software_version;
+      EIGER_CACHED_GET_PARAM(Requests::SOFTWARE_VERSION,software_version);
+      if(cache_loaded &&
+	 (m_detector_type != cached.detector_number ||
+	  software_version != cached.software_version))
+	{
+	  DEB_WARNING() << "Startup cache dropped, detector changed from "
+			<< cached.detector_number << " (" << cached.software_version
+			<< ") to " << m_detector_type << " (" << software_version << ")";
+	  m_startup_cache->remove();
+	}
+      setTrigMode(IntTrig);
+      _save_startup_cache();
+
+      if(m_maxImageWidth != prev_width || m_maxImageHeight != prev_height ||
+	 m_detectorImageType != prev_image_type)
+	{
+	  Size image_size;
+	  ImageType image_type;
+	  getDetectorMaxImageSize(image_size);
+	  getImageType(image_type);
+	  maxImageSizeChanged(image_size,image_type);
+	}
+    }
+  catch(Exception& e)
+    {
+      error_msg = e.getErrMsg();
+    }
+  catch(const eigerapi::EigerException &e)
+    {
+      error_msg = e.what();
+    }
+
+  AutoMutex lock(m_cond.mutex());
+  if(error_msg.empty())
+    m_initilize_state = IDLE;
+  else
+    {
+      DEB_ERROR() << "Startup failed: " << error_msg;
+      m_initilize_state = ERROR;
+    }
+  m_startup_running = false;
+  m_cond.broadcast();
+  DEB_ALWAYS() << "Startup finished";
+}
+
+/** detector requests wait for the startup thread, but its own ones
+ */
+void Camera::_wait_startup()
+{
+  AutoMutex lock(m_cond.mutex());
+  if(!m_startup_running || pthread_equal(m_startup_thread,pthread_self()))
+    return;
+  while(m_startup_running)
+    m_cond.wait();
+}
+
+/** rewrite the cache file if the detector description changed
+ */
+void Camera::_save_startup_cache()
+{
+  DEB_MEMBER_FUNCT();
+  StartupCache::Values values;
+  values.detector_number = m_detector_type;
+  m_param_cache->get(Requests::SOFTWARE_VERSION,values.software_version);
+  values.api_version = m_requests->get_api_version();
+  values.description = m_detector_model;
+  values.x_pixel_size = m_x_pixelsize;
+  values.y_pixel_size = m_y_pixelsize;
+  values.width = m_maxImageWidth;
+  values.height = m_maxImageHeight;
+  values.readout_time = m_readout_time;
+  values.min_frame_time = m_min_frame_time;
+  values.bit_depth_readout = m_bit_depth_readout;
+  m_param_cache->get(Requests::AUTO_SUMMATION,values.auto_summation);
+
+  StartupCache::Values cached;
+  if(m_startup_cache->load(cached) && cached == values)
+    return;
+  DEB_ALWAYS() << "Startup cache updated: " << m_startup_cache->getFilename();
+  m_startup_cache->save(values);
 }
 
 const std::string& Camera::getDetectorIp() const
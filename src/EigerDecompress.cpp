@@ -19,10 +19,19 @@
 // You should have received a copy of the GNU General Public License
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
 #include "lz4.h"
 
 #include "EigerDecompress.h"
 #include "EigerStream.h"
+#include "EigerFrameRing.h"
+#include "EigerAzimuthalIntegrator.h"
+#include "EigerSpotFinder.h"
+#include "EigerRecompress.h"
+#include "EigerRawDump.h"
 
 #include "processlib/LinkTask.h"
 #include "processlib/ProcessExceptions.h"
@@ -41,19 +50,265 @@ private:
   Stream& m_stream;
 };
 
-void _expend(void *src,Data& dst)
+/** lz4 decompression bounded by the message and destination sizes,
+ *  a message not filling the whole destination is an error too
+ */
+static inline int _lz4_decompress(const void* msg_data,size_t msg_size,
+				  void* dst,int dst_size)
+{
+  int size = LZ4_decompress_safe((const char*)msg_data,(char*)dst,int(msg_size),dst_size);
+  return (size < 0 || size == dst_size) ? size : -1;
+}
+
+/** widen 16 bits data to 32 bits, saturated (all-ones) pixels are
+ *  set to saturated_value (compare and select, vectorized by the compiler)
+ */
+static void _expend(const unsigned short* src_data,unsigned int* dst_data,int nbItems,
+		    unsigned int saturated_value)
+{
+  const unsigned short saturated = 0xffff;
+  for(int i = 0;i < nbItems;++i)
+    {
+      unsigned short raw = src_data[i];
+      dst_data[i] = raw == saturated ? saturated_value : raw;
+    }
+}
+
+/** widen 16 bits data to 32 bits and accumulate statistics.
+ *  loop is kept branch-less so the compiler can vectorize the reductions.
+ */
+static void _expend(const unsigned short* src_data,unsigned int* dst_data,int nbItems,
+		    unsigned int saturated_value,Camera::FrameStatistics& stat)
+{
+  const unsigned short saturated = 0xffff;
+  unsigned long long sum = 0;
+  unsigned int max = 0;
+  int nb_saturated = 0,nb_non_zero = 0;
+  for(int i = 0;i < nbItems;++i)
+    {
+      unsigned short raw = src_data[i];
+      int is_saturated = raw == saturated;
+      dst_data[i] = is_saturated ? saturated_value : raw;
+      unsigned int value = is_saturated ? 0 : raw;
+      sum += value;
+      max = value > max ? value : max;
+      nb_saturated += is_saturated;
+      nb_non_zero += value != 0;
+    }
+  stat.sum += sum;
+  if(max > stat.max) stat.max = max;
+  stat.nb_saturated += nb_saturated;
+  stat.nb_non_zero += nb_non_zero;
+}
+
+/** statistics of an already decompressed frame (no widening)
+ */
+template<class T>
+static void _statistics(const T* data,int nbItems,Camera::FrameStatistics& stat)
+{
+  const T saturated = std::numeric_limits<T>::max();
+  unsigned long long sum = 0;
+  unsigned int max = 0;
+  int nb_saturated = 0,nb_non_zero = 0;
+  for(int i = 0;i < nbItems;++i)
+    {
+      T raw = data[i];
+      int is_saturated = raw == saturated;
+      unsigned int value = is_saturated ? 0 : raw;
+      sum += value;
+      max = value > max ? value : max;
+      nb_saturated += is_saturated;
+      nb_non_zero += value != 0;
+    }
+  stat.sum += sum;
+  if(max > stat.max) stat.max = max;
+  stat.nb_saturated += nb_saturated;
+  stat.nb_non_zero += nb_non_zero;
+}
+
+static inline void _expend_segment(unsigned short* src,unsigned int* dst,int nbItems,
+				   unsigned int saturated_value,
+				   Camera::FrameStatistics* stat)
+{
+  if(stat)
+    _expend(src,dst,nbItems,saturated_value,*stat);
+  else
+    _expend(src,dst,nbItems,saturated_value);
+}
+
+/** widen 16 bits data to 32 bits, remap saturated pixels, clear masked
+ *  pixels and accumulate statistics in the same pass
+ */
+static void _expend(void *src,void* dst,int nbItems,
+		    const Decompress::PixelMask* pixel_mask,
+		    Camera::FrameStatistics* stat,
+		    unsigned int saturated_value)
 {
-  int nbItems = dst.size() / dst.depth();
   unsigned short* src_data = (unsigned short*)src;
-  unsigned int* dst_data = (unsigned int*)dst.data();
-  while(nbItems)
+  unsigned int* dst_data = (unsigned int*)dst;
+  int pos = 0;
+  if(pixel_mask)
+    {
+      const Decompress::PixelMask::Runs& runs = pixel_mask->m_runs;
+      for(Decompress::PixelMask::Runs::const_iterator i = runs.begin();
+	  i != runs.end() && pos < nbItems;++i)
+	{
+	  int start = std::min(i->first,nbItems);
+	  int end = std::min(i->first + i->second,nbItems);
+	  _expend_segment(src_data + pos,dst_data + pos,start - pos,saturated_value,stat);
+	  memset(dst_data + start,0,(end - start) * sizeof(unsigned int));
+	  pos = end;
+	}
+    }
+  _expend_segment(src_data + pos,dst_data + pos,nbItems - pos,saturated_value,stat);
+}
+
+/** narrow 32 bits auto summation data to 16 bits (see Camera::setAdaptiveImageType).
+ *  values above 0xfffe, as the all-ones detector sentinel, become the
+ *  0xffff saturation marker.
+ */
+static void _narrow(const unsigned int* src_data,unsigned short* dst_data,int nbItems)
+{
+  const unsigned int saturated = 0xffff;
+  for(int i = 0;i < nbItems;++i)
+    {
+      unsigned int raw = src_data[i];
+      dst_data[i] = (unsigned short)(raw > saturated ? saturated : raw);
+    }
+}
+
+/** clear masked pixels, only masked pixels are touched
+ */
+static void _apply_mask(void* dst,int nbItems,int depth,
+			const Decompress::PixelMask& pixel_mask)
+{
+  char* dst_data = (char*)dst;
+  const Decompress::PixelMask::Runs& runs = pixel_mask.m_runs;
+  for(Decompress::PixelMask::Runs::const_iterator i = runs.begin();
+      i != runs.end() && i->first < nbItems;++i)
+    {
+      int end = std::min(i->first + i->second,nbItems);
+      memset(dst_data + i->first * depth,0,(end - i->first) * depth);
+    }
+}
+
+/** set the saturated (all-ones) pixels of a 32 bits frame to saturated_value
+ */
+static void _remap_saturated(unsigned int* data,int nbItems,unsigned int saturated_value)
+{
+  const unsigned int saturated = 0xffffffff;
+  if(saturated_value == saturated)
+    return;
+  for(int i = 0;i < nbItems;++i)
+    data[i] = data[i] == saturated ? saturated_value : data[i];
+}
+
+/** add a decompressed frame into a 32 bits sum.
+ *  the sum saturates to 0xffffffff, and a saturated (all-ones)
+ *  source pixel gives a saturated sum pixel.
+ */
+template<class T>
+static void _accumulate(const T* src_data,unsigned int* dst_data,int nbItems,bool first)
+{
+  const T saturated = std::numeric_limits<T>::max();
+  const unsigned long long sum_max = std::numeric_limits<unsigned int>::max();
+  for(int i = 0;i < nbItems;++i)
+    {
+      T raw = src_data[i];
+      unsigned long long sum = (first ? 0ULL : dst_data[i]) + raw;
+      sum = sum > sum_max ? sum_max : sum;
+      dst_data[i] = raw == saturated ? (unsigned int)sum_max : (unsigned int)sum;
+    }
+}
+
+/** count the non-zero pixels of a frame
+ */
+template<class T>
+static int _count_non_zero(const T* data,int nbItems)
+{
+  int nb_non_zero = 0;
+  for(int i = 0;i < nbItems;++i)
+    nb_non_zero += data[i] != 0;
+  return nb_non_zero;
+}
+
+/** compact a frame into (pixel index,value) pairs.
+ *  every pixel is written and the output only advances on non-zero
+ *  values, so the loop has no data dependent branch.
+ *  pairs must have room for 2 * (nb_non_zero + 1) values.
+ */
+template<class T>
+static void _compact(const T* data,int nbItems,unsigned int* pairs)
+{
+  int pos = 0;
+  for(int i = 0;i < nbItems;++i)
+    {
+      T value = data[i];
+      pairs[2 * pos] = i;
+      pairs[2 * pos + 1] = value;
+      pos += value != 0;
+    }
+}
+
+/** @brief allocate a sparse frame of nb_pixels (pixel index,value) pairs.
+ *
+ *  The sparse frame is a (2,nb_pixels) UINT32 array, the header keeps the
+ *  dense frame geometry (sparse_width,sparse_height) so consumers can
+ *  rebuild it. One extra pair is allocated for the branch-less compaction.
+ */
+static void _sparse_frame(const Data& src,int nb_pixels,Data& sparse)
+{
+  sparse.type = Data::UINT32;
+  sparse.dimensions.push_back(2);
+  sparse.dimensions.push_back(nb_pixels);
+  sparse.frameNumber = src.frameNumber;
+  sparse.timestamp = src.timestamp;
+  sparse.header = src.header;
+  Buffer* buffer = new Buffer((nb_pixels + 1) * 2 * sizeof(unsigned int));
+  sparse.setBuffer(buffer);
+  buffer->unref();
+
+  char value[32];
+  sparse.header.insert("sparse","1");
+  snprintf(value,sizeof(value),"%d",src.dimensions[0]);
+  sparse.header.insert("sparse_width",value);
+  snprintf(value,sizeof(value),"%d",src.dimensions[1]);
+  sparse.header.insert("sparse_height",value);
+  sparse.header.insert("sparse_type",src.depth() == 2 ? "uint16" : "uint32");
+}
+
+/** @brief convert a frame to the sparse representation if its occupancy
+ *  is lower or equal to the threshold.
+ *  @return true if the sparse representation was built
+ */
+bool Decompress::toSparse(Data& src,double threshold,Data& sparse)
+{
+  int nbItems = src.size() / src.depth();
+  int nb_non_zero;
+  switch(src.depth())
     {
-      *dst_data = unsigned(*src_data);
-      ++dst_data,++src_data,--nbItems;
+    case 2: nb_non_zero = _count_non_zero((const unsigned short*)src.data(),nbItems);break;
+    case 4: nb_non_zero = _count_non_zero((const unsigned int*)src.data(),nbItems);break;
+    default: return false;
     }
-  dst.type = Data::UINT32;
+  if(nb_non_zero > threshold * nbItems)
+    return false;
+
+  _sparse_frame(src,nb_non_zero,sparse);
+  unsigned int* pairs = (unsigned int*)sparse.data();
+  if(src.depth() == 2)
+    _compact((const unsigned short*)src.data(),nbItems,pairs);
+  else
+    _compact((const unsigned int*)src.data(),nbItems,pairs);
+  return true;
 }
 
+/** clear masked pixels and compute statistics of a decompressed frame
+ */
+static void _post_process(void* dst,int nbItems,int depth,
+			  const Decompress::PixelMask* pixel_mask,
+			  Camera::FrameStatistics* stat);
+
 Data _DecompressTask::process(Data& src)
 {
   void *msg_data;
@@ -61,34 +316,117 @@ Data _DecompressTask::process(Data& src)
   int depth;
   if(!m_stream.get_msg(src.data(),msg_data,msg_size,depth))
     throw ProcessException("_DecompressTask: can't find compressed message");
-  void* dst;
-  int size;
-  if(src.depth() == 4 && depth == 2)
+
+  std::shared_ptr<const Decompress::PixelMask> pixel_mask = m_stream.get_pixel_mask();
+  FrameRing<Camera::FrameStatistics>* statistics_ring = m_stream.get_statistics();
+  Camera::FrameStatistics statistics;
+  Decompress::Message message = {msg_data,msg_size,depth};
+  Decompress::MessageList messages(1,message);
+  // software summation, the buffer is built from several messages
+  while(m_stream.get_msg(src.data(),message.data,message.size,message.depth,
+			 messages.size()))
+    messages.push_back(message);
+
+  if(messages.size() > 1 && src.depth() != 4)
+    throw ProcessException("_DecompressTask: summed frames must be 32 bits");
+
+  Size frame_size;
+  Roi roi;
+  m_stream.get_roi(frame_size,roi);
+  AzimuthalIntegrator* azimuthal_integrator = m_stream.get_azimuthal_integrator();
+  SpotFinder* spot_finder = m_stream.get_spot_finder();
+  double sparse_threshold = m_stream.get_sparse_threshold();
+  Recompress* recompress = m_stream.get_recompress();
+  std::shared_ptr<RawDump> raw_dump = m_stream.get_raw_dump();
+  // nothing to do on the frame, the lz4 message is already a chunk
+  Data chunk;
+  if(recompress && !raw_dump && messages.size() == 1 && depth == src.depth() &&
+     (depth == 2 || m_stream.get_saturated_value() == 0xffffffff) &&
+     !roi.isActive() && !pixel_mask && !statistics_ring &&
+     !azimuthal_integrator && !spot_finder && sparse_threshold <= 0. &&
+     recompress->wrap(src,msg_data,msg_size,chunk))
+    return chunk;
+
+  // with a raw dump, the frame is decompressed straight into the file
+  Data frame = src;
+  void* frame_ptr = raw_dump ? raw_dump->getFramePtr(src.frameNumber) : NULL;
+  if(frame_ptr)
     {
-    if(posix_memalign(&dst,16,src.size() / 2))
-	throw ProcessException("Can't allocate temporary memory");
-    size = src.size() / 2;
+      Buffer* buffer = new Buffer();
+      buffer->owner = Buffer::MAPPED;
+      buffer->data = frame_ptr;
+      frame.setBuffer(buffer);
+      buffer->unref();
     }
   else
-    dst = src.data(),size = src.size();
+    raw_dump.reset();
 
-  int return_code = LZ4_decompress_fast((const char*)msg_data,(char*)dst,size);
+  int return_code = Decompress::decompressFrames(messages,frame.data(),frame.size(),frame.depth(),
+						 frame_size,roi,pixel_mask.get(),
+						 statistics_ring ? &statistics : NULL,
+						 m_stream.get_saturated_value());
   if(return_code < 0)
     {
-      if(src.depth() == 4 && depth == 2) free(dst);
-
       char ErrorBuff[1024];
       snprintf(ErrorBuff,sizeof(ErrorBuff),
 	       "_DecompressTask: decompression failed, (error code: %d) (data size %d)",
-	       return_code,src.size());
+	       return_code,frame.size());
       throw ProcessException(ErrorBuff);
     }
-  if(src.depth() == 4 && depth == 2)
+  if(frame.depth() == 4 && depth == 2)
+    frame.type = Data::UINT32;
+  else if(frame.depth() == 2 && depth == 4)
+    frame.type = Data::UINT16;
+  if(raw_dump)
+    raw_dump->frameWritten(frame.frameNumber,frame.timestamp);
+  if(statistics_ring)
+    {
+      statistics.frame_nb = frame.frameNumber;
+      statistics_ring->write(frame.frameNumber,statistics);
+    }
+  // value of the saturated and invalid pixels in the decompressed frame
+  unsigned int saturated = frame.depth() == 4 ? m_stream.get_saturated_value() : 0xffff;
+  const unsigned char* masked = pixel_mask && !pixel_mask->m_masked.empty() ?
+    pixel_mask->m_masked.data() : NULL;
+  if(azimuthal_integrator)
+    azimuthal_integrator->integrate(frame.frameNumber,frame.data(),frame.depth(),
+				    saturated,masked);
+
+  bool veto = false;
+  if(spot_finder)
+    {
+      int nb_peaks = spot_finder->findSpots(frame.data(),frame.depth(),
+					    frame.dimensions[0],frame.dimensions[1],
+					    saturated,masked);
+      bool hit = spot_finder->isHit(nb_peaks);
+      char value[32];
+      snprintf(value,sizeof(value),"%d",nb_peaks);
+      frame.header.insert("nb_peaks",value);
+      frame.header.insert("hit",hit ? "1" : "0");
+      m_stream.get_nb_peaks()->write(frame.frameNumber,nb_peaks);
+      veto = !hit && spot_finder->getParameters().veto;
+    }
+
+  // a vetoed frame is dropped by the stream before it reaches Lima
+  if(veto)
+    return Data();
+  Data sparse;
+  if(sparse_threshold > 0. && Decompress::toSparse(frame,sparse_threshold,sparse))
+    return sparse;
+  if(recompress)
+    {
+      if(!recompress->compress(frame,chunk))
+	throw ProcessException("_DecompressTask: recompression failed");
+      return chunk;
+    }
+  if(raw_dump)
     {
-      _expend(dst,src);
-      free(dst);
+      // the frame is in the raw dump file, the Lima buffer is left as is
+      src.header.insert("raw_dump","1");
+      src.type = frame.type;
+      return src;
     }
-  return src;
+  return frame;
 }
 
 Decompress::Decompress(Stream& stream) :
@@ -106,6 +444,247 @@ LinkTask* Decompress::getReconstructionTask()
   return m_decompress_task;
 }
 
+/** @brief decompress a stream message into a frame buffer.
+ *
+ *  if the message depth is 16 bits and the destination is 32 bits,
+ *  data are widened after decompression (saturated pixels are set to
+ *  saturated_value), if the message depth is 32 bits and the destination
+ *  16 bits, data are narrowed (saturated to 0xffff).
+ *  masked pixels of pixel_mask (if any) are set to 0.
+ *  statistics (if any) are accumulated while data are widened.
+ *  @return the decompressed size (negative on error)
+ */
+int Decompress::decompressFrame(void* msg_data,size_t msg_size,int msg_depth,
+				void* dst,int dst_size,int dst_depth,
+				const PixelMask* pixel_mask,
+				Camera::FrameStatistics* statistics,
+				unsigned int saturated_value)
+{
+  void* decompress_dst;
+  int size;
+  bool expend = dst_depth == 4 && msg_depth == 2;
+  bool narrow = dst_depth == 2 && msg_depth == 4;
+  if(expend || narrow)
+    {
+      size = dst_size / dst_depth * msg_depth;
+      if(posix_memalign(&decompress_dst,16,size))
+	return -1;
+    }
+  else
+    decompress_dst = dst,size = dst_size;
+
+  int return_code = _lz4_decompress(msg_data,msg_size,decompress_dst,size);
+  if(expend)
+    {
+      if(return_code >= 0)
+	_expend(decompress_dst,dst,dst_size / dst_depth,pixel_mask,statistics,
+		saturated_value);
+      free(decompress_dst);
+    }
+  else if(narrow)
+    {
+      if(return_code >= 0)
+	{
+	  _narrow((const unsigned int*)decompress_dst,(unsigned short*)dst,
+		  dst_size / dst_depth);
+	  _post_process(dst,dst_size / dst_depth,dst_depth,pixel_mask,statistics);
+	}
+      free(decompress_dst);
+    }
+  else if(return_code >= 0)
+    {
+      _post_process(dst,dst_size / dst_depth,dst_depth,pixel_mask,statistics);
+      if(dst_depth == 4)
+	_remap_saturated((unsigned int*)dst,dst_size / dst_depth,saturated_value);
+    }
+  return return_code;
+}
+
+/** @brief decompress and sum several stream messages into a 32 bits frame.
+ *
+ *  used by the software summation, see Camera::setSoftwareSummation.
+ *  @return the lz4 return code of the first failing message
+ *  or of the last one.
+ */
+int Decompress::sumFrames(const MessageList& messages,
+			  void* dst,int dst_size,
+			  const PixelMask* pixel_mask,
+			  Camera::FrameStatistics* statistics,
+			  unsigned int saturated_value)
+{
+  int nbItems = dst_size / sizeof(unsigned int);
+  unsigned int* dst_data = (unsigned int*)dst;
+  void* decompress_dst;
+  if(posix_memalign(&decompress_dst,16,dst_size))
+    return -1;
+
+  int return_code = -1;
+  for(MessageList::const_iterator i = messages.begin();i != messages.end();++i)
+    {
+      bool first = i == messages.begin();
+      if(i->depth == 4)
+	{
+	  return_code = _lz4_decompress(i->data,i->size,first ? dst : decompress_dst,
+					dst_size);
+	  if(return_code < 0) break;
+	  if(!first)
+	    _accumulate((const unsigned int*)decompress_dst,dst_data,nbItems,false);
+	}
+      else
+	{
+	  return_code = _lz4_decompress(i->data,i->size,decompress_dst,nbItems * i->depth);
+	  if(return_code < 0) break;
+	  _accumulate((const unsigned short*)decompress_dst,dst_data,nbItems,first);
+	}
+    }
+  free(decompress_dst);
+
+  if(return_code >= 0)
+    {
+      _post_process(dst,nbItems,sizeof(unsigned int),pixel_mask,statistics);
+      _remap_saturated(dst_data,nbItems,saturated_value);
+    }
+  return return_code;
+}
+
+/** @brief decompress the messages of a Lima frame.
+ *
+ *  a single message is decompressed with decompressFrame, several
+ *  messages (software summation) are summed with sumFrames.
+ *  With an active roi, the full frame is decompressed into a temporary
+ *  buffer (with the message depth) and only the roi is widened (or narrowed) and copied
+ *  to dst, so statistics are the roi ones.
+ *  @param frame_size the full frame size sent by the detector
+ */
+int Decompress::decompressFrames(const MessageList& messages,
+				 void* dst,int dst_size,int dst_depth,
+				 const Size& frame_size,const Roi& roi,
+				 const PixelMask* pixel_mask,
+				 Camera::FrameStatistics* statistics,
+				 unsigned int saturated_value)
+{
+  if(messages.empty())
+    return -1;
+
+  bool sum = messages.size() > 1;
+  if(!roi.isActive())
+    {
+      if(sum)
+	return sumFrames(messages,dst,dst_size,pixel_mask,statistics,saturated_value);
+      const Message& message = messages.front();
+      return decompressFrame(message.data,message.size,message.depth,
+			     dst,dst_size,dst_depth,pixel_mask,statistics,
+			     saturated_value);
+    }
+
+  int frame_depth = sum ? 4 : messages.front().depth;
+  if((sum && dst_depth != 4) || roi.getSize().getWidth() *
+     roi.getSize().getHeight() * dst_depth > dst_size)
+    return -1;
+  int frame_width = frame_size.getWidth();
+  int frame_mem_size = frame_width * frame_size.getHeight() * frame_depth;
+  void* frame;
+  if(posix_memalign(&frame,16,frame_mem_size))
+    return -1;
+
+  int return_code;
+  if(sum)
+    return_code = sumFrames(messages,frame,frame_mem_size,pixel_mask);
+  else
+    {
+      const Message& message = messages.front();
+      return_code = decompressFrame(message.data,message.size,message.depth,
+				    frame,frame_mem_size,frame_depth,pixel_mask);
+    }
+
+  if(return_code >= 0)
+    {
+      Point top_left = roi.getTopLeft();
+      Size roi_size = roi.getSize();
+      int width = roi_size.getWidth();
+      const char* src_line = (const char*)frame +
+	(top_left.y * frame_width + top_left.x) * frame_depth;
+      char* dst_line = (char*)dst;
+      for(int line = 0;line < roi_size.getHeight();++line)
+	{
+	  if(frame_depth == dst_depth)
+	    {
+	      memcpy(dst_line,src_line,width * dst_depth);
+	      _post_process(dst_line,width,dst_depth,NULL,statistics);
+	      if(dst_depth == 4)
+		_remap_saturated((unsigned int*)dst_line,width,saturated_value);
+	    }
+	  else if(dst_depth == 4)
+	    _expend_segment((unsigned short*)src_line,(unsigned int*)dst_line,
+			    width,saturated_value,statistics);
+	  else
+	    {
+	      _narrow((const unsigned int*)src_line,(unsigned short*)dst_line,width);
+	      _post_process(dst_line,width,dst_depth,NULL,statistics);
+	    }
+	  src_line += frame_width * frame_depth;
+	  dst_line += width * dst_depth;
+	}
+    }
+  free(frame);
+  return return_code;
+}
+
+static void _post_process(void* dst,int nbItems,int depth,
+			  const Decompress::PixelMask* pixel_mask,
+			  Camera::FrameStatistics* stat)
+{
+  if(pixel_mask)
+    _apply_mask(dst,nbItems,depth,*pixel_mask);
+  if(stat)
+    {
+      if(depth == 2)
+	_statistics((const unsigned short*)dst,nbItems,*stat);
+      else
+	_statistics((const unsigned int*)dst,nbItems,*stat);
+    }
+}
+
+int Decompress::PixelMask::getNbMaskedPixels() const
+{
+  int nb_pixels = 0;
+  for(Runs::const_iterator i = m_runs.begin();i != m_runs.end();++i)
+    nb_pixels += i->second;
+  return nb_pixels;
+}
+
+/** @brief flag the masked pixels of the frame seen after the software roi.
+ *
+ *  the azimuthal integration and the spot finding skip them, masked pixels
+ *  are cleared so they can't be told from a zero count.
+ */
+void Decompress::PixelMask::buildMasked(const Size& frame_size,const Roi& roi)
+{
+  Roi frame_roi = roi.isActive() ? roi : Roi(Point(0,0),frame_size);
+  int width = frame_size.getWidth();
+  Point top_left = frame_roi.getTopLeft();
+  int roi_width = frame_roi.getSize().getWidth();
+  int roi_height = frame_roi.getSize().getHeight();
+
+  m_masked.assign(size_t(roi_width) * roi_height,0);
+  for(Runs::const_iterator i = m_runs.begin();i != m_runs.end();++i)
+    for(int pixel = i->first;pixel < i->first + i->second;++pixel)
+      {
+	int x = pixel % width - top_left.x,y = pixel / width - top_left.y;
+	if(x >= 0 && x < roi_width && y >= 0 && y < roi_height)
+	  m_masked[y * roi_width + x] = 1;
+      }
+  m_masked_roi = frame_roi;
+}
+
+bool Decompress::PixelMask::isMaskedBuilt(const Size& frame_size,const Roi& roi) const
+{
+  Roi frame_roi = roi.isActive() ? roi : Roi(Point(0,0),frame_size);
+  return (!m_masked.empty() &&
+	  m_masked_roi.getTopLeft() == frame_roi.getTopLeft() &&
+	  m_masked_roi.getSize() == frame_roi.getSize());
+}
+
 void Decompress::setActive(bool active)
 {
   reconstructionChange(active ? m_decompress_task : NULL);
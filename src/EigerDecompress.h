@@ -22,8 +22,13 @@
 #ifndef EIGERDECOMPRESS_H
 #define EIGERDECOMPRESS_H
 
+#include <vector>
+
 #include "lima/Debug.h"
 #include "lima/HwReconstructionCtrlObj.h"
+#include "processlib/Data.h"
+
+#include "EigerCamera.h"
 
 namespace lima
 {
@@ -34,15 +39,76 @@ namespace lima
     {
       DEB_CLASS_NAMESPC(DebModCamera,"Decompress","Eiger");
     public:
+      /** Detector pixel mask stored as a list of masked pixel runs
+	  (first pixel index,nb pixels)
+      */
+      class PixelMask
+      {
+      public:
+	typedef std::vector<std::pair<int,int> > Runs;
+
+	PixelMask() : m_nb_pixels(0) {}
+	template<class T>
+	void build(const T* mask,int nb_pixels);
+	void buildMasked(const Size& frame_size,const Roi& roi);
+	bool isMaskedBuilt(const Size& frame_size,const Roi& roi) const;
+	int getNbMaskedPixels() const;
+
+	Runs m_runs;
+	int m_nb_pixels;		///< size of the frame it applies to
+	Roi m_masked_roi;		///< roi of m_masked
+	std::vector<unsigned char> m_masked; ///< one byte per pixel of the roi frame
+      };
+      /// a compressed stream message
+      struct Message
+      {
+	void*	data;
+	size_t	size;
+	int	depth;
+      };
+      typedef std::vector<Message> MessageList;
+      
       Decompress(Stream&);
       virtual ~Decompress();
 
       virtual LinkTask* getReconstructionTask();
 
       void setActive(bool);
+
+      static int decompressFrame(void* msg_data,size_t msg_size,int msg_depth,
+				 void* dst,int dst_size,int dst_depth,
+				 const PixelMask* pixel_mask = NULL,
+				 Camera::FrameStatistics* statistics = NULL,
+				 unsigned int saturated_value = 0xffffffff);
+      static int sumFrames(const MessageList& messages,
+			   void* dst,int dst_size,
+			   const PixelMask* pixel_mask = NULL,
+			   Camera::FrameStatistics* statistics = NULL,
+			   unsigned int saturated_value = 0xffffffff);
+      static int decompressFrames(const MessageList& messages,
+				  void* dst,int dst_size,int dst_depth,
+				  const Size& frame_size,const Roi& roi,
+				  const PixelMask* pixel_mask = NULL,
+				  Camera::FrameStatistics* statistics = NULL,
+				  unsigned int saturated_value = 0xffffffff);
+      static bool toSparse(Data& src,double threshold,Data& sparse);
     private:
       LinkTask* m_decompress_task;
     };
+
+    template<class T>
+    void Decompress::PixelMask::build(const T* mask,int nb_pixels)
+    {
+      m_runs.clear();
+      m_nb_pixels = nb_pixels;
+      for(int i = 0;i < nb_pixels;++i)
+	{
+	  if(!mask[i]) continue;
+	  int start = i;
+	  while(i < nb_pixels && mask[i]) ++i;
+	  m_runs.push_back(std::make_pair(start,i - start));
+	}
+    }
   }
 }
 #endif
@@ -0,0 +1,101 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERFRAMERING_H
+#define EIGERFRAMERING_H
+
+#include <atomic>
+#include <vector>
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Lock-free ring of per frame results indexed by frame number.
+     *
+     *  Each slot is protected by a sequence counter (odd while written),
+     *  writers never block readers and readers retry on concurrent write.
+     *  T must be trivially copyable.
+     */
+    template<class T>
+    class FrameRing
+    {
+    public:
+      FrameRing(int size) : m_slots(size),m_last_frame(-1) {clear();}
+
+      void clear()
+      {
+	for(typename std::vector<Slot>::iterator i = m_slots.begin();
+	    i != m_slots.end();++i)
+	  i->frame_nb = -1;
+	m_last_frame = -1;
+      }
+
+      void write(int frame_nb,const T& value)
+      {
+	Slot& slot = m_slots[frame_nb % m_slots.size()];
+	unsigned seq = slot.seq.load(std::memory_order_relaxed);
+	// an other writer is using this slot (ring wrapped), drop the value
+	if((seq & 1) ||
+	   !slot.seq.compare_exchange_strong(seq,seq + 1,std::memory_order_acquire))
+	  return;
+	slot.frame_nb = frame_nb;
+	slot.value = value;
+	slot.seq.store(seq + 2,std::memory_order_release);
+
+	int last_frame = m_last_frame.load(std::memory_order_relaxed);
+	while(frame_nb > last_frame &&
+	      !m_last_frame.compare_exchange_weak(last_frame,frame_nb));
+      }
+
+      bool read(int frame_nb,T& value) const
+      {
+	const Slot& slot = m_slots[frame_nb % m_slots.size()];
+	unsigned seq;
+	int slot_frame_nb;
+	do
+	  {
+	    seq = slot.seq.load(std::memory_order_acquire);
+	    if(seq & 1) continue;
+	    slot_frame_nb = slot.frame_nb;
+	    value = slot.value;
+	    std::atomic_thread_fence(std::memory_order_acquire);
+	  }
+	while((seq & 1) || slot.seq.load(std::memory_order_relaxed) != seq);
+	return slot_frame_nb == frame_nb;
+      }
+
+      int lastFrame() const {return m_last_frame.load();}
+      int size() const {return m_slots.size();}
+    private:
+      struct Slot
+      {
+	Slot() : seq(0),frame_nb(-1) {}
+	std::atomic<unsigned>	seq;
+	int			frame_nb;
+	T			value;
+      };
+      std::vector<Slot>		m_slots;
+      std::atomic<int>		m_last_frame;
+    };
+  }
+}
+#endif
@@ -0,0 +1,293 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "lima/Exceptions.h"
+#include "lima/Timestamp.h"
+#include "EigerFutureImpl.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+using namespace eigerapi;
+
+//			  --- Future::Impl ---
+Future::Impl::Impl(Requests& requests_,FutureCompletion& completion_) :
+  requests(requests_),
+  completion(completion_),
+  value_type(Future::None),
+  status(Future::Running),
+  future(NULL),
+  callback(NULL),
+  in_callback(false)
+{
+}
+
+/** the request keeps this as callback until the future is finished
+ */
+void Future::Impl::start(std::shared_ptr<CurlLoop::FutureRequest> request)
+{
+  m_request = request;
+  std::shared_ptr<CurlLoop::FutureRequest::Callback> cbk(shared_from_this());
+  request->register_callback(cbk);
+}
+
+void Future::Impl::status_changed(CurlLoop::FutureRequest::Status)
+{
+  completion.push(shared_from_this());
+}
+
+/** called by the completion thread, the request is finished
+ */
+void Future::Impl::complete()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(cond.mutex());
+  if(status != Future::Running)
+    return;
+  std::shared_ptr<CurlLoop::FutureRequest> request = m_request;
+  lock.unlock();
+
+  try
+    {
+      request->wait();
+      if(on_success) on_success();
+    }
+  catch(const eigerapi::EigerException& e)
+    {
+      _finish(Future::Failed,e.what());
+      return;
+    }
+  catch(Exception& e)
+    {
+      _finish(Future::Failed,e.getErrMsg());
+      return;
+    }
+  _finish(Future::Done,"");
+}
+
+void Future::Impl::cancel()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(cond.mutex());
+  if(status != Future::Running)
+    return;
+  std::shared_ptr<CurlLoop::FutureRequest> request = m_request;
+  lock.unlock();
+
+  requests.cancel(request);
+  _finish(Future::Cancelled,"Cancelled");
+}
+
+/** set the final status once, wake up the waiters and call the callback.
+ *  the request is released here, breaking the request <-> future cycle.
+ */
+void Future::Impl::_finish(Future::Status final_status,const std::string& error_msg)
+{
+  AutoMutex lock(cond.mutex());
+  if(status != Future::Running)
+    return;
+  status = final_status;
+  error = error_msg;
+  m_request.reset();
+  cond.broadcast();
+  if(!future || !callback)
+    return;
+  Future* current_future = future;
+  Future::Callback* current_callback = callback;
+  in_callback = true;
+  callback_thread = pthread_self();
+  lock.unlock();
+
+  current_callback->done(*current_future);
+
+  lock.lock();
+  in_callback = false;
+  cond.broadcast();
+}
+
+//			  --- FutureCompletion ---
+FutureCompletion::FutureCompletion() :
+  m_stop(false),
+  m_joined(false)
+{
+  pthread_create(&m_thread,NULL,_runFunc,this);
+}
+
+FutureCompletion::~FutureCompletion()
+{
+  stop();
+}
+
+/** stop the completion thread, futures pushed after are never completed.
+ *  the object must outlive the requests which may still push to it.
+ */
+void FutureCompletion::stop()
+{
+  AutoMutex lock(m_cond.mutex());
+  m_stop = true;
+  m_cond.broadcast();
+  if(m_joined) return;
+  m_joined = true;
+  lock.unlock();
+  pthread_join(m_thread,NULL);
+}
+
+void FutureCompletion::push(std::shared_ptr<Future::Impl> impl)
+{
+  AutoMutex lock(m_cond.mutex());
+  m_pending.push_back(impl);
+  m_cond.signal();
+}
+
+void* FutureCompletion::_runFunc(void* completion)
+{
+  ((FutureCompletion*)completion)->_run();
+  return NULL;
+}
+
+void FutureCompletion::_run()
+{
+  AutoMutex lock(m_cond.mutex());
+  while(1)
+    {
+      while(m_pending.empty() && !m_stop)
+	m_cond.wait();
+      if(m_stop) break;
+
+      std::shared_ptr<Future::Impl> impl = m_pending.front();
+      m_pending.pop_front();
+      lock.unlock();
+      impl->complete();
+      impl.reset();
+      lock.lock();
+    }
+}
+
+//			     --- Future ---
+Future::Future(std::shared_ptr<Impl> impl) :
+  m_impl(impl)
+{
+  AutoMutex lock(m_impl->cond.mutex());
+  m_impl->future = this;
+}
+
+Future::~Future()
+{
+  AutoMutex lock(m_impl->cond.mutex());
+  while(m_impl->in_callback &&
+	!pthread_equal(m_impl->callback_thread,pthread_self()))
+    m_impl->cond.wait();
+  m_impl->future = NULL;
+}
+
+Future::Status Future::getStatus() const
+{
+  AutoMutex lock(m_impl->cond.mutex());
+  return m_impl->status;
+}
+
+bool Future::isDone() const
+{
+  return getStatus() != Running;
+}
+
+/** wait for the request, timeout < 0 waits forever.
+ *  throws if the request failed, was cancelled or on timeout
+ */
+void Future::wait(double timeout) const
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_impl->cond.mutex());
+  if(timeout < 0.)
+    {
+      while(m_impl->status == Running)
+	m_impl->cond.wait();
+    }
+  else
+    {
+      double end = Timestamp::now() + timeout;
+      while(m_impl->status == Running)
+	{
+	  double remaining = end - Timestamp::now();
+	  if(remaining <= 0.)
+	    THROW_HW_ERROR(Error) << "Timeout";
+	  m_impl->cond.wait(remaining);
+	}
+    }
+  if(m_impl->status != Done)
+    THROW_HW_ERROR(Error) << m_impl->error;
+}
+
+void Future::cancel()
+{
+  m_impl->cancel();
+}
+
+Future::ValueType Future::getValueType() const
+{
+  return m_impl->value_type;
+}
+
+void Future::getValue(bool& value) const
+{
+  DEB_MEMBER_FUNCT();
+  wait();
+  if(m_impl->value_type != Bool)
+    THROW_HW_ERROR(InvalidValue) << "Not a bool value";
+  value = m_impl->value.data.bool_val;
+}
+
+void Future::getValue(double& value) const
+{
+  DEB_MEMBER_FUNCT();
+  wait();
+  if(m_impl->value_type != Double)
+    THROW_HW_ERROR(InvalidValue) << "Not a double value";
+  value = m_impl->value.data.double_val;
+}
+
+void Future::getValue(std::string& value) const
+{
+  DEB_MEMBER_FUNCT();
+  wait();
+  if(m_impl->value_type != String)
+    THROW_HW_ERROR(InvalidValue) << "Not a string value";
+  value = m_impl->value.string_val;
+}
+
+std::string Future::getErrorMessage() const
+{
+  AutoMutex lock(m_impl->cond.mutex());
+  return m_impl->error;
+}
+
+/** the callback is called at once if the future is already finished,
+ *  it's not owned by the future.
+ */
+void Future::setCallback(Callback* callback)
+{
+  AutoMutex lock(m_impl->cond.mutex());
+  m_impl->callback = callback;
+  bool done = m_impl->status != Running;
+  lock.unlock();
+
+  if(done && callback)
+    callback->done(*this);
+}
@@ -0,0 +1,105 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERFUTUREIMPL_H
+#define EIGERFUTUREIMPL_H
+
+#include <pthread.h>
+#include <functional>
+#include <list>
+#include <memory>
+
+#include "lima/ThreadUtils.h"
+
+#include "EigerFuture.h"
+#include <eigerapi/EigerDefines.h>
+#include <eigerapi/Requests.h>
+
+namespace lima
+{
+  namespace Eiger
+  {
+    class FutureCompletion;
+
+    /** state shared by a Future and its request.
+     *
+     *  the curl loop calls status_changed with the request locked and
+     *  before the request result is decoded, so the completion is done
+     *  by the FutureCompletion thread.
+     */
+    struct Future::Impl : public eigerapi::CurlLoop::FutureRequest::Callback,
+			  public std::enable_shared_from_this<Future::Impl>
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"Future::Impl","Eiger");
+    public:
+      Impl(eigerapi::Requests&,FutureCompletion&);
+
+      void start(std::shared_ptr<eigerapi::CurlLoop::FutureRequest>);
+      virtual void status_changed(eigerapi::CurlLoop::FutureRequest::Status);
+      void complete();
+      void cancel();
+
+      eigerapi::Requests&		requests;
+      FutureCompletion&			completion;
+      /// typed destination of a get request
+      Future::ValueType			value_type;
+      eigerapi::Requests::Param::Value	value;
+      /// run by the completion thread when the request succeeded
+      std::function<void()>		on_success;
+
+      Cond				cond;
+      Future::Status			status;
+      std::string			error;
+      Future*				future;
+      Future::Callback*			callback;
+      /// the future can't be deleted while its callback runs in another thread
+      bool				in_callback;
+      pthread_t				callback_thread;
+    private:
+      void _finish(Future::Status,const std::string& error);
+
+      std::shared_ptr<eigerapi::CurlLoop::FutureRequest> m_request;
+    };
+
+    /** thread finishing the futures whose request is done
+     */
+    class FutureCompletion
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"FutureCompletion","Eiger");
+    public:
+      FutureCompletion();
+      ~FutureCompletion();
+
+      void stop();
+      void push(std::shared_ptr<Future::Impl>);
+    private:
+      static void* _runFunc(void*);
+      void _run();
+
+      Cond					m_cond;
+      bool					m_stop;
+      pthread_t					m_thread;
+      bool					m_joined;
+      std::list<std::shared_ptr<Future::Impl> >	m_pending;
+    };
+  }
+}
+#endif	// EIGERFUTUREIMPL_H
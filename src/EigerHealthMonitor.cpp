@@ -0,0 +1,242 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <math.h>
+#include <sched.h>
+#include <algorithm>
+
+#include "lima/Timestamp.h"
+#include "EigerHealthMonitor.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+using namespace eigerapi;
+
+static const int HEALTH_RING_SIZE = 1024;
+// how often a paused monitor checks if the acquisition is finished
+static const double ACQ_CHECK_PERIOD = 1.;
+
+HealthMonitor::HealthMonitor(Camera& cam,Requests& requests) :
+  m_cam(cam),
+  m_requests(requests),
+  m_stop(false),
+  m_thread_running(false),
+  m_period(0.),
+  m_acq_period(0.),
+  m_acquiring(false),
+  m_temperature(0.),
+  m_humidity(0.),
+  m_history(HEALTH_RING_SIZE),
+  m_nb_samples(0),
+  m_last_status_timestamp(0.)
+{
+}
+
+HealthMonitor::~HealthMonitor()
+{
+  _stop_thread();
+}
+
+/** period <= 0 stops the monitor, acq_period <= 0 pauses it during
+ *  acquisitions.
+ */
+void HealthMonitor::setPeriod(double period,double acq_period)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(period,acq_period);
+
+  if(period <= 0.)
+    {
+      _stop_thread();
+      AutoMutex lock(m_cond.mutex());
+      m_period = 0.;
+      m_acq_period = std::max(acq_period,0.);
+      return;
+    }
+
+  AutoMutex lock(m_cond.mutex());
+  m_period = period;
+  m_acq_period = std::max(acq_period,0.);
+  if(m_thread_running)
+    {
+      m_cond.broadcast();
+      return;
+    }
+  m_stop = false;
+  if(pthread_create(&m_thread,NULL,_runFunc,this))
+    THROW_HW_ERROR(Error) << "Can't start the health monitor thread";
+  m_thread_running = true;
+}
+
+void HealthMonitor::getPeriod(double& period,double& acq_period) const
+{
+  AutoMutex lock(m_cond.mutex());
+  period = m_period;
+  acq_period = m_acq_period;
+}
+
+/** a sample is served while it's younger than twice the period in use
+ *  (period or acq_period), never if the monitor is stopped.
+ *  While it's paused by an acquisition, the last sample is served as aged:
+ *  the detector is not polled during the acquisition.
+ */
+bool HealthMonitor::_is_fresh(double timestamp,bool& aged) const
+{
+  AutoMutex lock(m_cond.mutex());
+  aged = false;
+  if(!m_thread_running) return false;
+  double period = m_acquiring ? m_acq_period : m_period;
+  if(m_acquiring && period <= 0.)
+    return aged = true;
+  return period > 0. && Timestamp::now() - timestamp <= 2 * period;
+}
+
+/** @return false if the monitor is stopped, has no sample yet
+ *  or the last sample is too old
+ */
+bool HealthMonitor::getLastSample(Camera::HealthSample& sample) const
+{
+  int last = m_history.lastFrame();
+  return (last >= 0 && m_history.read(last,sample) &&
+	  _is_fresh(sample.timestamp,sample.aged));
+}
+
+bool HealthMonitor::getLastStatus(std::string& status,bool& aged) const
+{
+  double timestamp;
+  {
+    AutoMutex lock(m_status_mutex);
+    if(m_last_status.empty()) return false;
+    status = m_last_status;
+    timestamp = m_last_status_timestamp;
+  }
+  return _is_fresh(timestamp,aged);
+}
+
+/** samples oldest first, a request which failed is NaN
+ */
+void HealthMonitor::getHistory(std::vector<Camera::HealthSample>& samples) const
+{
+  samples.clear();
+  int last = m_history.lastFrame();
+  for(int nb = std::max(0,last - m_history.size() + 1);nb <= last;++nb)
+    {
+      Camera::HealthSample sample;
+      if(m_history.read(nb,sample))
+	samples.push_back(sample);
+    }
+}
+
+void HealthMonitor::_stop_thread()
+{
+  AutoMutex lock(m_cond.mutex());
+  if(!m_thread_running) return;
+  m_stop = true;
+  m_cond.broadcast();
+  lock.unlock();
+
+  pthread_join(m_thread,NULL);
+
+  lock.lock();
+  m_thread_running = false;
+}
+
+void* HealthMonitor::_runFunc(void* monitor)
+{
+  // only polls the detector, must not compete with the acquisition threads
+  struct sched_param param;
+  param.sched_priority = 0;
+  pthread_setschedparam(pthread_self(),SCHED_IDLE,&param);
+
+  ((HealthMonitor*)monitor)->_run();
+  return NULL;
+}
+
+void HealthMonitor::_run()
+{
+  double last_refresh = -1.;
+  AutoMutex lock(m_cond.mutex());
+  while(!m_stop)
+    {
+      lock.unlock();
+      bool acquiring = m_cam.getStatus() == Camera::Exposure;
+      lock.lock();
+      if(m_stop) break;
+      m_acquiring = acquiring;
+
+      double period = acquiring ? m_acq_period : m_period;
+      double now = Timestamp::now();
+      if(period > 0. && (last_refresh < 0. || now - last_refresh >= period))
+	{
+	  lock.unlock();
+	  _refresh();
+	  lock.lock();
+	  last_refresh = now;
+	  continue;
+	}
+
+      double timeout = ACQ_CHECK_PERIOD;
+      if(period > 0.)
+	timeout = std::min(timeout,last_refresh + period - now);
+      m_cond.wait(timeout);
+    }
+}
+
+/** send the three requests at once, then collect them
+ */
+void HealthMonitor::_refresh()
+{
+  DEB_MEMBER_FUNCT();
+  std::shared_ptr<Requests::Param> temperature_req =
+    m_requests.get_param(Requests::TEMP,m_temperature);
+  std::shared_ptr<Requests::Param> humidity_req =
+    m_requests.get_param(Requests::HUMIDITY,m_humidity);
+  std::shared_ptr<Requests::Param> status_req =
+    m_requests.get_param(Requests::DETECTOR_STATUS,m_status);
+
+  Camera::HealthSample sample;
+  sample.aged = false;
+  sample.temperature = _wait(temperature_req) ? m_temperature : NAN;
+  sample.humidity = _wait(humidity_req) ? m_humidity : NAN;
+  bool status_ok = _wait(status_req);
+  sample.timestamp = Timestamp::now();
+  m_history.write(m_nb_samples++,sample);
+
+  AutoMutex lock(m_status_mutex);
+  m_last_status = status_ok ? m_status : "";
+  m_last_status_timestamp = sample.timestamp;
+}
+
+bool HealthMonitor::_wait(std::shared_ptr<Requests::Param>& request)
+{
+  DEB_MEMBER_FUNCT();
+  try
+    {
+      request->wait();
+      return true;
+    }
+  catch(const eigerapi::EigerException &e)
+    {
+      m_requests.cancel(request);
+      DEB_TRACE() << "Health request failed: " << e.what();
+      return false;
+    }
+}
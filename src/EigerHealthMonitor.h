@@ -0,0 +1,95 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERHEALTHMONITOR_H
+#define EIGERHEALTHMONITOR_H
+
+#include <pthread.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+#include "EigerCamera.h"
+#include "EigerFrameRing.h"
+
+#include <eigerapi/EigerDefines.h>
+#include <eigerapi/Requests.h>
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Background refresh of the detector temperature, humidity and state.
+     *
+     *  a low priority thread sends the three requests together every
+     *  period (every acq_period while an acquisition is running, 0 pauses
+     *  it) and keeps the samples in a ring, so the Camera getters are
+     *  served from memory instead of doing a request each. A sample older
+     *  than twice the current period is not served, the getters do the
+     *  request. While paused by an acquisition the last sample is served,
+     *  marked as aged, so the detector is never polled during it.
+     */
+    class HealthMonitor
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"HealthMonitor","Eiger");
+    public:
+      HealthMonitor(Camera&,eigerapi::Requests&);
+      ~HealthMonitor();
+
+      void setPeriod(double period,double acq_period);
+      void getPeriod(double& period,double& acq_period) const;
+
+      bool getLastSample(Camera::HealthSample&) const;
+      bool getLastStatus(std::string&,bool& aged) const;
+      void getHistory(std::vector<Camera::HealthSample>&) const;
+    private:
+      static void* _runFunc(void*);
+      void _run();
+      void _refresh();
+      bool _wait(std::shared_ptr<eigerapi::Requests::Param>&);
+      void _stop_thread();
+      bool _is_fresh(double timestamp,bool& aged) const;
+
+      Camera&				m_cam;
+      eigerapi::Requests&		m_requests;
+      mutable Cond			m_cond;
+      bool				m_stop;
+      bool				m_thread_running;
+      pthread_t				m_thread;
+      double				m_period;
+      double				m_acq_period;
+      bool				m_acquiring;
+      // request destinations, only used by the monitor thread
+      double				m_temperature;
+      double				m_humidity;
+      std::string			m_status;
+      FrameRing<Camera::HealthSample>	m_history;
+      int				m_nb_samples;
+      mutable Mutex			m_status_mutex;
+      std::string			m_last_status;
+      double				m_last_status_timestamp;
+    };
+  }
+}
+#endif	// EIGERHEALTHMONITOR_H
@@ -53,6 +53,7 @@ Interface::Interface(Camera& cam) : m_cam(cam)
   m_cap_list.push_back(HwCap(buffer));	
 
   m_decompress = new Decompress(*m_stream);
+  m_stream->setDecompress(m_decompress);
   m_cap_list.push_back(HwCap(m_decompress));
 }
 
@@ -95,8 +96,38 @@ void Interface::reset(ResetLevel reset_level)
 void Interface::prepareAcq()
 {
     DEB_MEMBER_FUNCT();
+    int nb_summed_frames;
+    m_cam.getSoftwareSummation(nb_summed_frames);
+    if(m_saving->isActive() && nb_summed_frames > 1)
+      THROW_HW_ERROR(NotSupported) << "Software summation is only available with the stream";
+
+    Camera::DecompressionPlacement placement;
+    m_cam.getDecompressionPlacement(placement);
+    if(!m_saving->isActive())
+      {
+	double sparse_threshold;
+	m_cam.getSparseThreshold(sparse_threshold);
+	bool recompression;
+	m_cam.getRecompression(recompression);
+	Camera::SpotFindingParameters spot_finding;
+	m_cam.getSpotFinding(spot_finding);
+	bool variable_frame_shape;
+	m_cam.getVariableFrameShape(variable_frame_shape);
+	// these frames don't have the Lima frame shape
+	bool reshaped = (sparse_threshold > 0. || recompression);
+	if(reshaped && placement != Camera::PROCESSLIB)
+	  THROW_HW_ERROR(NotSupported) << "Sparse frames and recompression "
+				       << "need the processlib decompression";
+	// processlib can't drop a frame
+	if(spot_finding.active && spot_finding.veto && placement != Camera::RECEIVE_THREAD)
+	  THROW_HW_ERROR(NotSupported) << "Spot finding veto needs the receive thread decompression";
+	if(reshaped && !variable_frame_shape)
+	  THROW_HW_ERROR(NotSupported) << "Sparse frames and recompressed chunks can't be saved by Lima, "
+				       << "switch Lima saving off and setVariableFrameShape(True)";
+      }
+
     m_stream->setActive(!m_saving->isActive());
-    m_decompress->setActive(!m_saving->isActive());
+    m_decompress->setActive(!m_saving->isActive() && placement == Camera::PROCESSLIB);
     
     m_cam.prepareAcq();
     int serie_id; m_cam.getSerieId(serie_id);
@@ -0,0 +1,353 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "EigerParamCache.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+using namespace eigerapi;
+
+/** parameters read at controller initialisation
+ */
+static const struct
+{
+  Requests::PARAM_NAME		name;
+  Requests::Param::VALUE_TYPE	type;
+} PREFETCHED_PARAMS[] = {
+  {Requests::COUNTRATE_CORRECTION,	Requests::Param::BOOL},
+  {Requests::FLATFIELD_CORRECTION,	Requests::Param::BOOL},
+  {Requests::EFFICIENCY_CORRECTION,	Requests::Param::BOOL},
+  {Requests::PIXEL_MASK,		Requests::Param::BOOL},
+  {Requests::VIRTUAL_PIXEL_CORRECTION,	Requests::Param::BOOL},
+  {Requests::FILEWRITER_COMPRESSION,	Requests::Param::BOOL},
+  {Requests::THRESHOLD_ENERGY,		Requests::Param::DOUBLE},
+  {Requests::PHOTON_ENERGY,		Requests::Param::DOUBLE},
+  {Requests::HEADER_WAVELENGTH,		Requests::Param::DOUBLE},
+  {Requests::HEADER_BEAM_CENTER_X,	Requests::Param::DOUBLE},
+  {Requests::HEADER_BEAM_CENTER_Y,	Requests::Param::DOUBLE},
+  {Requests::HEADER_DETECTOR_DISTANCE,	Requests::Param::DOUBLE},
+  {Requests::HEADER_CHI_INCREMENT,	Requests::Param::DOUBLE},
+  {Requests::HEADER_CHI_START,		Requests::Param::DOUBLE},
+  {Requests::HEADER_KAPPA_INCREMENT,	Requests::Param::DOUBLE},
+  {Requests::HEADER_KAPPA_START,	Requests::Param::DOUBLE},
+  {Requests::HEADER_OMEGA_INCREMENT,	Requests::Param::DOUBLE},
+  {Requests::HEADER_OMEGA_START,	Requests::Param::DOUBLE},
+  {Requests::HEADER_PHI_INCREMENT,	Requests::Param::DOUBLE},
+  {Requests::HEADER_PHI_START,		Requests::Param::DOUBLE},
+  {Requests::SOFTWARE_VERSION,		Requests::Param::STRING},
+};
+static const int NB_PREFETCHED_PARAMS = sizeof(PREFETCHED_PARAMS) / sizeof(PREFETCHED_PARAMS[0]);
+
+/** header parameters are only metadata, setting them changes nothing else
+ */
+bool ParamCache::isHeaderParam(Name name)
+{
+  switch(name)
+    {
+    case Requests::HEADER_BEAM_CENTER_X:
+    case Requests::HEADER_BEAM_CENTER_Y:
+    case Requests::HEADER_CHI_INCREMENT:
+    case Requests::HEADER_CHI_START:
+    case Requests::HEADER_DETECTOR_DISTANCE:
+    case Requests::HEADER_KAPPA_INCREMENT:
+    case Requests::HEADER_KAPPA_START:
+    case Requests::HEADER_OMEGA_INCREMENT:
+    case Requests::HEADER_OMEGA_START:
+    case Requests::HEADER_PHI_INCREMENT:
+    case Requests::HEADER_PHI_START:
+      return true;
+    default:
+      return false;
+    }
+}
+
+ParamCache::ParamCache() :
+  m_fetched(NB_PREFETCHED_PARAMS)
+{
+}
+
+bool ParamCache::_get(Name name,Value& value) const
+{
+  AutoMutex lock(m_mutex);
+  std::map<int,Value>::const_iterator i = m_values.find(name);
+  if(i == m_values.end() || i->second.type != value.type)
+    return false;
+  value = i->second;
+  return true;
+}
+
+void ParamCache::_set(Name name,const Value& value)
+{
+  AutoMutex lock(m_mutex);
+  m_values[name] = value;
+}
+
+/** @brief a parameter was successfully set on the detector.
+ *
+ *  the detector recomputes other parameters when its configuration
+ *  changes (e.g. the threshold with the photon energy). Without the
+ *  list of a set reply (see refreshChanged), all but header parameters
+ *  empty the cache before keeping the new value.
+ */
+void ParamCache::_changed(Name name,const Value& value)
+{
+  AutoMutex lock(m_mutex);
+  if(!isHeaderParam(name))
+    m_values.clear();
+  m_values[name] = value;
+}
+
+bool ParamCache::get(Name name,bool& value) const
+{
+  Value cached;
+  cached.type = Requests::Param::BOOL;
+  if(!_get(name,cached)) return false;
+  value = cached.data.bool_val;
+  return true;
+}
+
+bool ParamCache::get(Name name,double& value) const
+{
+  Value cached;
+  cached.type = Requests::Param::DOUBLE;
+  if(!_get(name,cached)) return false;
+  value = cached.data.double_val;
+  return true;
+}
+
+bool ParamCache::get(Name name,int& value) const
+{
+  Value cached;
+  cached.type = Requests::Param::INT;
+  if(!_get(name,cached)) return false;
+  value = cached.data.int_val;
+  return true;
+}
+
+bool ParamCache::get(Name name,unsigned int& value) const
+{
+  Value cached;
+  cached.type = Requests::Param::UNSIGNED;
+  if(!_get(name,cached)) return false;
+  value = cached.data.unsigned_val;
+  return true;
+}
+
+bool ParamCache::get(Name name,std::string& value) const
+{
+  Value cached;
+  cached.type = Requests::Param::STRING;
+  if(!_get(name,cached)) return false;
+  value = cached.string_val;
+  return true;
+}
+
+static inline Requests::Param::Value _value(bool value)
+{
+  Requests::Param::Value v;
+  v.type = Requests::Param::BOOL;
+  v.data.bool_val = value;
+  return v;
+}
+
+static inline Requests::Param::Value _value(double value)
+{
+  Requests::Param::Value v;
+  v.type = Requests::Param::DOUBLE;
+  v.data.double_val = value;
+  return v;
+}
+
+static inline Requests::Param::Value _value(int value)
+{
+  Requests::Param::Value v;
+  v.type = Requests::Param::INT;
+  v.data.int_val = value;
+  return v;
+}
+
+static inline Requests::Param::Value _value(unsigned int value)
+{
+  Requests::Param::Value v;
+  v.type = Requests::Param::UNSIGNED;
+  v.data.unsigned_val = value;
+  return v;
+}
+
+static inline Requests::Param::Value _value(const std::string& value)
+{
+  Requests::Param::Value v;
+  v.type = Requests::Param::STRING;
+  v.string_val = value;
+  return v;
+}
+
+void ParamCache::set(Name name,bool value) {_set(name,_value(value));}
+void ParamCache::set(Name name,double value) {_set(name,_value(value));}
+void ParamCache::set(Name name,int value) {_set(name,_value(value));}
+void ParamCache::set(Name name,unsigned int value) {_set(name,_value(value));}
+void ParamCache::set(Name name,const std::string& value) {_set(name,_value(value));}
+
+void ParamCache::changed(Name name,bool value) {_changed(name,_value(value));}
+void ParamCache::changed(Name name,double value) {_changed(name,_value(value));}
+void ParamCache::changed(Name name,int value) {_changed(name,_value(value));}
+void ParamCache::changed(Name name,unsigned int value) {_changed(name,_value(value));}
+void ParamCache::changed(Name name,const std::string& value) {_changed(name,_value(value));}
+void ParamCache::changed(Name name,const char* value) {_changed(name,_value(std::string(value)));}
+
+/** @brief re-read the cached parameters changed by a finished set request.
+ *
+ *  the set reply lists the parameters the detector changed with it
+ *  (e.g. the threshold with the photon energy), the cached ones are
+ *  read again all together. A parameter which can't be read is dropped.
+ *  A listed parameter unknown to the plugin is not cached, it is ignored.
+ *  @return false if the reply has no list
+ */
+bool ParamCache::refreshChanged(Requests& requests,
+				const std::shared_ptr<Requests::Param>& request,
+				Name name)
+{
+  DEB_MEMBER_FUNCT();
+  std::vector<std::string> changed_params;
+  if(!request->get_changed_params(changed_params))
+    return false;
+  DEB_TRACE() << DEB_VAR2(name,changed_params.size());
+
+  std::vector<std::pair<Name,Value> > refreshed;
+  {
+    AutoMutex lock(m_mutex);
+    for(size_t i = 0;i < changed_params.size();++i)
+      {
+	Name changed_name;
+	// a parameter the plugin doesn't know can't be in the cache
+	if(!Requests::find_param(name,changed_params[i],changed_name))
+	  {
+	    DEB_TRACE() << "Unknown changed parameter " << changed_params[i]
+			<< " ignored";
+	    continue;
+	  }
+	if(changed_name == name)
+	  continue;
+	std::map<int,Value>::iterator cached = m_values.find(changed_name);
+	if(cached == m_values.end())
+	  continue;
+	refreshed.push_back(std::make_pair(changed_name,cached->second));
+	m_values.erase(cached);
+      }
+  }
+
+  RequestList request_list;
+  for(size_t i = 0;i < refreshed.size();++i)
+    {
+      Value& value = refreshed[i].second;
+      switch(value.type)
+	{
+	case Requests::Param::BOOL:
+	  request_list.push_back(requests.get_param(refreshed[i].first,value.data.bool_val));break;
+	case Requests::Param::DOUBLE:
+	  request_list.push_back(requests.get_param(refreshed[i].first,value.data.double_val));break;
+	case Requests::Param::INT:
+	  request_list.push_back(requests.get_param(refreshed[i].first,value.data.int_val));break;
+	case Requests::Param::UNSIGNED:
+	  request_list.push_back(requests.get_param(refreshed[i].first,value.data.unsigned_val));break;
+	default:
+	  request_list.push_back(requests.get_param(refreshed[i].first,value.string_val));break;
+	}
+    }
+
+  RequestList::iterator refresh_request = request_list.begin();
+  for(size_t i = 0;i < refreshed.size();++i,++refresh_request)
+    {
+      try
+	{
+	  (*refresh_request)->wait();
+	  _set(refreshed[i].first,refreshed[i].second);
+	}
+      catch(const eigerapi::EigerException &e)
+	{
+	  requests.cancel(*refresh_request);
+	  DEB_TRACE() << "Not refreshed: " << refreshed[i].first << ": " << e.what();
+	}
+    }
+  return true;
+}
+
+/** the detector configuration may have changed (initialize,...)
+ */
+void ParamCache::invalidate()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex lock(m_mutex);
+  m_values.clear();
+}
+
+/** @brief start reading the cached parameters.
+ *
+ *  requests are appended to request_list, the caller waits for them
+ *  and calls commit().
+ */
+void ParamCache::prefetch(Requests& requests,RequestList& request_list)
+{
+  DEB_MEMBER_FUNCT();
+  for(int i = 0;i < NB_PREFETCHED_PARAMS;++i)
+    {
+      Requests::PARAM_NAME name = PREFETCHED_PARAMS[i].name;
+      Value& value = m_fetched[i];
+      value.type = PREFETCHED_PARAMS[i].type;
+      switch(value.type)
+	{
+	case Requests::Param::BOOL:
+	  request_list.push_back(requests.get_param(name,value.data.bool_val));break;
+	case Requests::Param::DOUBLE:
+	  request_list.push_back(requests.get_param(name,value.data.double_val));break;
+	default:
+	  request_list.push_back(requests.get_param(name,value.string_val));break;
+	}
+    }
+}
+
+/** keep the prefetched values, a parameter which couldn't be read
+ *  (not available on this detector) stays out of the cache.
+ */
+void ParamCache::commit(Requests& requests,RequestList& request_list)
+{
+  DEB_MEMBER_FUNCT();
+  std::vector<bool> fetched(NB_PREFETCHED_PARAMS,false);
+  RequestList::iterator request = request_list.begin();
+  for(int i = 0;i < NB_PREFETCHED_PARAMS && request != request_list.end();++i,++request)
+    {
+      try
+	{
+	  (*request)->wait();
+	  fetched[i] = true;
+	}
+      catch(const eigerapi::EigerException &e)
+	{
+	  requests.cancel(*request);
+	  DEB_TRACE() << "Not cached: " << PREFETCHED_PARAMS[i].name << ": " << e.what();
+	}
+    }
+
+  AutoMutex lock(m_mutex);
+  for(int i = 0;i < NB_PREFETCHED_PARAMS;++i)
+    if(fetched[i])
+      m_values[PREFETCHED_PARAMS[i].name] = m_fetched[i];
+}
@@ -0,0 +1,111 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERPARAMCACHE_H
+#define EIGERPARAMCACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+#include <eigerapi/EigerDefines.h>
+#include <eigerapi/Requests.h>
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Typed client side cache of the detector parameters.
+     *
+     *  values are kept with the type they were read or written with, a read
+     *  with an other type is a miss. The cache is filled by prefetch()/commit()
+     *  at controller initialisation, updated by successful sets and emptied
+     *  when the detector may have changed its configuration by itself.
+     */
+    class ParamCache
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"ParamCache","Eiger");
+    public:
+      typedef eigerapi::Requests::PARAM_NAME Name;
+      typedef std::list<std::shared_ptr<eigerapi::Requests::Param> > RequestList;
+
+      ParamCache();
+
+      static bool isHeaderParam(Name);
+
+      bool get(Name,bool&) const;
+      bool get(Name,double&) const;
+      bool get(Name,int&) const;
+      bool get(Name,unsigned int&) const;
+      bool get(Name,std::string&) const;
+
+      void set(Name,bool);
+      void set(Name,double);
+      void set(Name,int);
+      void set(Name,unsigned int);
+      void set(Name,const std::string&);
+      void set(Name name,const char* value) {set(name,std::string(value));}
+
+      void changed(Name,bool);
+      void changed(Name,double);
+      void changed(Name,int);
+      void changed(Name,unsigned int);
+      void changed(Name,const std::string&);
+      void changed(Name,const char*);
+
+      /// a set request succeeded: only the parameters listed in its
+      /// reply are re-read, without list as changed(name,value)
+      template<class T>
+      void changed(eigerapi::Requests& requests,
+		   const std::shared_ptr<eigerapi::Requests::Param>& request,
+		   Name name,const T& value)
+      {
+	if(refreshChanged(requests,request,name))
+	  set(name,value);
+	else
+	  changed(name,value);
+      }
+      bool refreshChanged(eigerapi::Requests&,
+			  const std::shared_ptr<eigerapi::Requests::Param>& request,
+			  Name);
+
+      void invalidate();
+
+      void prefetch(eigerapi::Requests&,RequestList&);
+      void commit(eigerapi::Requests&,RequestList&);
+    private:
+      typedef eigerapi::Requests::Param::Value Value;
+      bool _get(Name,Value&) const;
+      void _set(Name,const Value&);
+      void _changed(Name,const Value&);
+
+      mutable Mutex		m_mutex;
+      std::map<int,Value>	m_values;
+      std::vector<Value>	m_fetched;
+    };
+  }
+}
+#endif	// EIGERPARAMCACHE_H
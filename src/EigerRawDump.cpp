@@ -0,0 +1,150 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "lima/Exceptions.h"
+#include "EigerRawDump.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+RawDump::RawDump(const std::string& filename,int nb_frames,const FrameDim& frame_dim) :
+  m_filename(filename),
+  m_nb_frames(nb_frames),
+  m_frame_size(frame_dim.getMemSize()),
+  m_fd(-1),
+  m_frames(NULL),
+  m_index_fd(-1),
+  m_index(NULL)
+{
+  DEB_CONSTRUCTOR();
+  DEB_PARAM() << DEB_VAR3(filename,nb_frames,frame_dim);
+
+  if(nb_frames <= 0)
+    THROW_HW_ERROR(InvalidValue) << "Raw dump needs a fixed number of frames";
+
+  size_t index_size = sizeof(IndexHeader) + nb_frames * sizeof(IndexEntry);
+  try
+    {
+      m_frames = (char*)_map(filename,m_frame_size * nb_frames,m_fd);
+      m_index = (IndexHeader*)_map(filename + ".index",index_size,m_index_fd);
+    }
+  catch(...)
+    {
+      // the frame file was created here, don't leave it without index
+      if(m_frames)
+	{
+	  _unmap(m_frames,m_frame_size * nb_frames,m_fd);
+	  unlink(filename.c_str());
+	}
+      throw;
+    }
+  madvise(m_frames,m_frame_size * nb_frames,MADV_SEQUENTIAL);
+
+  memcpy(m_index->magic,"EIGERRAW",sizeof(m_index->magic));
+  m_index->version = 1;
+  m_index->nb_frames = nb_frames;
+  m_index->width = frame_dim.getSize().getWidth();
+  m_index->height = frame_dim.getSize().getHeight();
+  m_index->depth = frame_dim.getDepth();
+  m_index->reserved = 0;
+  m_index->frame_size = m_frame_size;
+  IndexEntry* entries = (IndexEntry*)(m_index + 1);
+  for(int i = 0;i < nb_frames;++i)
+    {
+      entries[i].frame_nb = -1;
+      entries[i].offset = i * m_frame_size;
+      entries[i].timestamp = 0.;
+    }
+}
+
+RawDump::~RawDump()
+{
+  DEB_DESTRUCTOR();
+  _unmap(m_frames,m_frame_size * m_nb_frames,m_fd);
+  _unmap(m_index,sizeof(IndexHeader) + m_nb_frames * sizeof(IndexEntry),m_index_fd);
+}
+
+/** @brief create and map a file of size bytes.
+ *
+ *  an existing file is not overwritten, it may be a previous acquisition.
+ */
+void* RawDump::_map(const std::string& filename,size_t size,int& fd)
+{
+  DEB_MEMBER_FUNCT();
+  fd = open(filename.c_str(),O_RDWR | O_CREAT | O_EXCL,0644);
+  if(fd < 0)
+    THROW_HW_ERROR(Error) << "Can't create raw dump file " << filename
+			  << ": " << strerror(errno);
+  // reserve the blocks now, not while frames are written
+  int error = posix_fallocate(fd,0,size);
+  if(error)
+    {
+      close(fd);
+      THROW_HW_ERROR(Error) << "Can't allocate " << size << " bytes for "
+			    << filename << ": " << strerror(error);
+    }
+  void* ptr = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  if(ptr == MAP_FAILED)
+    {
+      close(fd);
+      THROW_HW_ERROR(Error) << "Can't map raw dump file " << filename
+			    << ": " << strerror(errno);
+    }
+  return ptr;
+}
+
+void RawDump::_unmap(void* ptr,size_t size,int fd)
+{
+  msync(ptr,size,MS_ASYNC);
+  munmap(ptr,size);
+  close(fd);
+}
+
+/** @return the file address of frame_nb or NULL if out of the file
+ */
+void* RawDump::getFramePtr(int frame_nb) const
+{
+  if(frame_nb < 0 || frame_nb >= m_nb_frames)
+    return NULL;
+  return m_frames + frame_nb * m_frame_size;
+}
+
+/** record the frame in the index and start its writeback
+ */
+void RawDump::frameWritten(int frame_nb,double timestamp)
+{
+  DEB_MEMBER_FUNCT();
+  if(frame_nb < 0 || frame_nb >= m_nb_frames)
+    return;
+
+  IndexEntry& entry = ((IndexEntry*)(m_index + 1))[frame_nb];
+  entry.timestamp = timestamp;
+  entry.frame_nb = frame_nb;
+  if(sync_file_range(m_fd,entry.offset,m_frame_size,SYNC_FILE_RANGE_WRITE))
+    DEB_WARNING() << "Raw dump writeback of frame " << frame_nb
+		  << " failed: " << strerror(errno);
+}
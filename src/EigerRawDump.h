@@ -0,0 +1,84 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERRAWDUMP_H
+#define EIGERRAWDUMP_H
+
+#include <stdint.h>
+#include <string>
+
+#include "lima/Debug.h"
+#include "lima/SizeUtils.h"
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Raw binary dump of the decompressed frames.
+     *
+     *  frames are decompressed straight into a pre-allocated memory mapped
+     *  file at offset frame_nb * frame_size. A memory mapped sidecar index
+     *  (filename + ".index") holds an IndexHeader followed by one IndexEntry
+     *  per frame. Writeback of each frame is started as soon as it is written
+     *  and done by the kernel in the background.
+     */
+    class RawDump
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"RawDump","Eiger");
+    public:
+      struct IndexHeader
+      {
+	char		magic[8];	///< "EIGERRAW"
+	uint32_t	version;
+	uint32_t	nb_frames;
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	depth;
+	uint32_t	reserved;
+	uint64_t	frame_size;
+      };
+      struct IndexEntry
+      {
+	int64_t		frame_nb;	///< -1 if the frame was not written
+	uint64_t	offset;
+	double		timestamp;
+      };
+
+      RawDump(const std::string& filename,int nb_frames,const FrameDim&);
+      ~RawDump();
+
+      void* getFramePtr(int frame_nb) const;
+      void frameWritten(int frame_nb,double timestamp);
+    private:
+      void* _map(const std::string& filename,size_t size,int& fd);
+      void _unmap(void* ptr,size_t size,int fd);
+
+      std::string	m_filename;
+      int		m_nb_frames;
+      size_t		m_frame_size;
+      int		m_fd;
+      char*		m_frames;
+      int		m_index_fd;
+      IndexHeader*	m_index;
+    };
+  }
+}
+#endif	// EIGERRAWDUMP_H
@@ -0,0 +1,297 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "lz4.h"
+#ifdef WITH_BITSHUFFLE
+#include "bitshuffle.h"
+#endif
+
+#include "EigerRecompress.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+static const int CHUNK_HEADER_SIZE = 12;
+// lz4 filter block size, bslz4 uses the bitshuffle default (8 KB)
+static const int LZ4_BLOCK_SIZE = 256 * 1024;
+static const int BSLZ4_BLOCK_SIZE = 8192;
+// slices per thread, to balance blocks of different entropy
+static const int NB_SLICES_PER_THREAD = 4;
+
+/** a frame to recompress, split in slices of whole blocks
+ */
+struct Recompress::_Job
+{
+  Camera::CompressionType	type;
+  const char*			src;
+  int				nb_items;
+  int				depth;
+  int				block_items;
+  int				slice_items;
+  int				next_slice;
+  int				nb_done;
+  bool				error;
+  std::vector<std::vector<char> > slices;
+};
+
+static inline void _write_uint32_be(char* dst,uint32_t value)
+{
+  for(int i = 3;i >= 0;--i,value >>= 8)
+    dst[i] = char(value & 0xff);
+}
+
+static inline void _write_uint64_be(char* dst,uint64_t value)
+{
+  for(int i = 7;i >= 0;--i,value >>= 8)
+    dst[i] = char(value & 0xff);
+}
+
+/** @brief fill the chunk frame.
+ *
+ *  the chunk is a UINT8 frame with the chunk bytes, the header keeps the
+ *  dense frame geometry (compressed_width,compressed_height,compressed_type).
+ *  @return the chunk buffer
+ */
+static char* _init_chunk(const Data& src,const char* compression,int chunk_size,
+			 Data& chunk)
+{
+  chunk.type = Data::UINT8;
+  chunk.dimensions.push_back(chunk_size);
+  chunk.frameNumber = src.frameNumber;
+  chunk.timestamp = src.timestamp;
+  chunk.header = src.header;
+  Buffer* buffer = new Buffer(chunk_size);
+  chunk.setBuffer(buffer);
+  buffer->unref();
+
+  char value[32];
+  chunk.header.insert("compressed",compression);
+  snprintf(value,sizeof(value),"%d",src.dimensions[0]);
+  chunk.header.insert("compressed_width",value);
+  snprintf(value,sizeof(value),"%d",src.dimensions[1]);
+  chunk.header.insert("compressed_height",value);
+  chunk.header.insert("compressed_type",src.depth() == 2 ? "uint16" : "uint32");
+  return (char*)buffer->data;
+}
+
+Recompress::Recompress() :
+  m_type(Camera::LZ4),
+  m_stop(false)
+{
+}
+
+Recompress::~Recompress()
+{
+  _stop_threads();
+}
+
+bool Recompress::isSupported(Camera::CompressionType type)
+{
+#ifdef WITH_BITSHUFFLE
+  return true;
+#else
+  return type == Camera::LZ4;
+#endif
+}
+
+/** set the codec and (re)start the pool if the number of threads changed
+ */
+void Recompress::setParameters(Camera::CompressionType type,int nb_threads)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR2(type,nb_threads);
+
+  if(!isSupported(type))
+    THROW_HW_ERROR(NotSupported) << "bslz4 recompression needs the bitshuffle library";
+  m_type = type;
+  if(int(m_threads.size()) == nb_threads)
+    return;
+
+  _stop_threads();
+  AutoMutex lock(m_cond.mutex());
+  m_stop = false;
+  m_threads.resize(nb_threads);
+  for(int i = 0;i < nb_threads;++i)
+    pthread_create(&m_threads[i],NULL,_runFunc,this);
+}
+
+void Recompress::_stop_threads()
+{
+  AutoMutex lock(m_cond.mutex());
+  m_stop = true;
+  m_cond.broadcast();
+  lock.unlock();
+
+  for(std::vector<pthread_t>::iterator i = m_threads.begin();i != m_threads.end();++i)
+    pthread_join(*i,NULL);
+  m_threads.clear();
+}
+
+void* Recompress::_runFunc(void* recompress)
+{
+  ((Recompress*)recompress)->_run();
+  return NULL;
+}
+
+void Recompress::_run()
+{
+  AutoMutex lock(m_cond.mutex());
+  while(1)
+    {
+      while(m_jobs.empty() && !m_stop)
+	m_cond.wait();
+      if(m_stop) break;
+
+      _Job* job = m_jobs.front();
+      int slice = job->next_slice++;
+      if(job->next_slice == int(job->slices.size()))
+	m_jobs.pop_front();
+
+      lock.unlock();
+      int first_item = slice * job->slice_items;
+      int nb_items = std::min(job->slice_items,job->nb_items - first_item);
+      bool ok = _compress_slice(job->type,job->src + size_t(first_item) * job->depth,
+				nb_items,job->depth,job->block_items,
+				job->slices[slice]);
+      lock.lock();
+
+      if(!ok) job->error = true;
+      if(++job->nb_done == int(job->slices.size()))
+	m_cond.broadcast();
+    }
+}
+
+/** compress a slice of whole blocks (but the last slice).
+ *  compressed slices are concatenated after the chunk header.
+ */
+bool Recompress::_compress_slice(Camera::CompressionType type,const char* src,
+				 int nb_items,int depth,int block_items,
+				 std::vector<char>& out)
+{
+#ifdef WITH_BITSHUFFLE
+  if(type == Camera::BSLZ4)
+    {
+      out.resize(bshuf_compress_lz4_bound(nb_items,depth,block_items));
+      int64_t size = bshuf_compress_lz4(src,out.data(),nb_items,depth,block_items);
+      if(size < 0) return false;
+      out.resize(size);
+      return true;
+    }
+#endif
+  int block_size = block_items * depth;
+  int size = nb_items * depth;
+  int nb_blocks = (size + block_size - 1) / block_size;
+  out.resize(nb_blocks * (4 + LZ4_compressBound(block_size)));
+  char* dst = out.data();
+  for(int offset = 0;offset < size;offset += block_size)
+    {
+      int src_size = std::min(block_size,size - offset);
+      int compressed_size = LZ4_compress_default(src + offset,dst + 4,src_size,
+						 LZ4_compressBound(block_size));
+      if(compressed_size <= 0) return false;
+      // not compressible blocks are stored raw, as the hdf5 lz4 filter does
+      if(compressed_size >= src_size)
+	{
+	  memcpy(dst + 4,src + offset,src_size);
+	  compressed_size = src_size;
+	}
+      _write_uint32_be(dst,compressed_size);
+      dst += 4 + compressed_size;
+    }
+  out.resize(dst - out.data());
+  return true;
+}
+
+/** @brief recompress a decompressed frame into a chunk.
+ *
+ *  the frame is split in slices compressed by the pool threads,
+ *  the calling thread waits for the slices and builds the chunk.
+ */
+bool Recompress::compress(const Data& src,Data& chunk)
+{
+  DEB_MEMBER_FUNCT();
+  int depth = src.depth();
+  if(m_threads.empty() || (depth != 2 && depth != 4))
+    return false;
+
+  _Job job;
+  job.type = m_type;
+  job.src = (const char*)src.data();
+  job.nb_items = src.size() / depth;
+  job.depth = depth;
+  job.block_items = (m_type == Camera::BSLZ4 ? BSLZ4_BLOCK_SIZE : LZ4_BLOCK_SIZE) / depth;
+  int nb_blocks = (job.nb_items + job.block_items - 1) / job.block_items;
+  int nb_slices = std::min(nb_blocks,int(m_threads.size()) * NB_SLICES_PER_THREAD);
+  if(nb_slices < 1) return false;
+  job.slice_items = (nb_blocks + nb_slices - 1) / nb_slices * job.block_items;
+  job.slices.resize((job.nb_items + job.slice_items - 1) / job.slice_items);
+  job.next_slice = 0;
+  job.nb_done = 0;
+  job.error = false;
+
+  AutoMutex lock(m_cond.mutex());
+  m_jobs.push_back(&job);
+  m_cond.broadcast();
+  while(job.nb_done < int(job.slices.size()))
+    m_cond.wait();
+  lock.unlock();
+  if(job.error) return false;
+
+  int chunk_size = CHUNK_HEADER_SIZE;
+  for(size_t i = 0;i < job.slices.size();++i)
+    chunk_size += job.slices[i].size();
+  char* dst = _init_chunk(src,m_type == Camera::BSLZ4 ? "bslz4" : "lz4",chunk_size,chunk);
+  _write_uint64_be(dst,uint64_t(src.size()));
+  _write_uint32_be(dst + 8,job.block_items * depth);
+  dst += CHUNK_HEADER_SIZE;
+  for(size_t i = 0;i < job.slices.size();++i)
+    {
+      memcpy(dst,job.slices[i].data(),job.slices[i].size());
+      dst += job.slices[i].size();
+    }
+  return true;
+}
+
+/** @brief build a lz4 chunk directly from a lz4 stream message.
+ *
+ *  the message is the whole frame compressed in one lz4 block, so it
+ *  only gets the chunk header, without being decompressed.
+ *  @return false if the message can't be used as is
+ */
+bool Recompress::wrap(const Data& src,const void* msg_data,size_t msg_size,Data& chunk)
+{
+  DEB_MEMBER_FUNCT();
+  if(m_type != Camera::LZ4 || msg_size >= size_t(src.size()))
+    return false;
+
+  int chunk_size = CHUNK_HEADER_SIZE + 4 + msg_size;
+  char* dst = _init_chunk(src,"lz4",chunk_size,chunk);
+  _write_uint64_be(dst,uint64_t(src.size()));
+  _write_uint32_be(dst + 8,src.size());
+  _write_uint32_be(dst + CHUNK_HEADER_SIZE,msg_size);
+  memcpy(dst + CHUNK_HEADER_SIZE + 4,msg_data,msg_size);
+  return true;
+}
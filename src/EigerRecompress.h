@@ -0,0 +1,78 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERRECOMPRESS_H
+#define EIGERRECOMPRESS_H
+
+#include <pthread.h>
+#include <list>
+#include <vector>
+
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+#include "processlib/Data.h"
+
+#include "EigerCamera.h"
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Recompression of frames into hdf5 filter chunks for direct chunk writes.
+     *
+     *  chunks are in the hdf5 lz4 filter (32004) or bitshuffle filter
+     *  (32008, bslz4) format: a 12 bytes header (big endian frame size and
+     *  block size) followed by independently compressed blocks, so slices
+     *  of blocks are compressed in parallel by a pool of threads.
+     *  bslz4 needs the bitshuffle library (build with BITSHUFFLE=1).
+     */
+    class Recompress
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"Recompress","Eiger");
+    public:
+      Recompress();
+      ~Recompress();
+
+      static bool isSupported(Camera::CompressionType);
+
+      void setParameters(Camera::CompressionType,int nb_threads);
+      Camera::CompressionType getType() const {return m_type;}
+
+      bool compress(const Data& src,Data& chunk);
+      bool wrap(const Data& src,const void* msg_data,size_t msg_size,Data& chunk);
+    private:
+      struct _Job;
+      static void* _runFunc(void*);
+      void _run();
+      void _stop_threads();
+      static bool _compress_slice(Camera::CompressionType,const char* src,
+				  int nb_items,int depth,int block_items,
+				  std::vector<char>& out);
+
+      Camera::CompressionType	m_type;
+      Cond			m_cond;
+      bool			m_stop;
+      std::vector<pthread_t>	m_threads;
+      std::list<_Job*>		m_jobs;
+    };
+  }
+}
+#endif	// EIGERRECOMPRESS_H
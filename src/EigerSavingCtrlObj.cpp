@@ -21,6 +21,7 @@
 //###########################################################################
 #include <algorithm>
 #include "EigerSavingCtrlObj.h"
+#include "EigerParamCache.h"
 
 #include <eigerapi/Requests.h>
 #include <eigerapi/EigerDefines.h>
@@ -145,6 +146,10 @@ void SavingCtrlObj::setCommonHeader(const HwSavingCtrlObj::HeaderMap& header)
 	 m_cam.m_requests->cancel(*i);
        THROW_HW_ERROR(Error) << e.what();
     }
+  for(HwSavingCtrlObj::HeaderMap::const_iterator i = header.begin();
+      i != header.end();++i)
+    if(!ParamCache::isHeaderParam(Requests::PARAM_NAME(m_availables_header_keys[i->first])))
+      m_cam._config_changed();
 }
 
 void SavingCtrlObj::resetCommonHeader()
@@ -192,6 +197,7 @@ void SavingCtrlObj::_setActive(bool active)
 				active_str);
   DEB_TRACE() << "FILEWRITER_MODE:" << DEB_VAR1(active_str);
   active_req->wait();
+  m_cam._config_changed();
 }
 
 void SavingCtrlObj::_prepare()
@@ -209,6 +215,8 @@ void SavingCtrlObj::_prepare()
   DEB_TRACE() << "FILEWRITER_NAME_PATTERN" << DEB_VAR1(m_prefix);
 
   nb_image_per_file_req->wait(),name_pattern_req->wait();
+  // new files need a new series
+  m_cam._config_changed();
 
   AutoMutex lock(m_cond.mutex());
   m_nb_file_transfer_started = m_nb_file_to_watch = 0;
@@ -0,0 +1,186 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <math.h>
+#include <algorithm>
+
+#include "EigerSpotFinder.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+SpotFinder::SpotFinder()
+{
+}
+
+void SpotFinder::setParameters(const Camera::SpotFindingParameters& parameters)
+{
+  DEB_MEMBER_FUNCT();
+  m_parameters = parameters;
+}
+
+/** @brief flag the strong pixels of a frame.
+ *
+ *  the local background is computed with a sliding box: column sums over
+ *  the box lines are updated line by line, then summed horizontally,
+ *  so memory is O(width) and the cost does not depend on the box size.
+ *  saturated (or invalid) pixels and masked pixels are ignored.
+ */
+template<class T>
+void SpotFinder::_strong_pixels(const T* data,int width,int height,
+				T saturated,const unsigned char* masked,
+				std::vector<unsigned char>& strong) const
+{
+  // invalid pixels, one byte per pixel
+  std::vector<unsigned char> invalid(size_t(width) * height);
+  for(int i = 0;i < width * height;++i)
+    invalid[i] = (data[i] == saturated) | (masked ? masked[i] : 0);
+  int half = m_parameters.half_box_size;
+  double sigma_threshold = m_parameters.sigma_threshold;
+  double sigma_background = m_parameters.sigma_background;
+  double min_count = m_parameters.min_count;
+
+  std::vector<double> column_sum(width,0.),column_sum2(width,0.);
+  std::vector<int> column_nb(width,0);
+  // box lines [y - half,y + half], the first lines are preloaded
+  for(int y = 0;y < std::min(half,height);++y)
+    {
+      const T* line = data + y * width;
+      const unsigned char* invalid_line = &invalid[y * width];
+      for(int x = 0;x < width;++x)
+	{
+	  double value = !invalid_line[x] ? line[x] : 0.;
+	  column_sum[x] += value;
+	  column_sum2[x] += value * value;
+	  column_nb[x] += !invalid_line[x];
+	}
+    }
+
+  for(int y = 0;y < height;++y)
+    {
+      int enter = y + half,leave = y - half - 1;
+      if(enter < height)
+	{
+	  const T* line = data + enter * width;
+	  const unsigned char* invalid_line = &invalid[enter * width];
+	  for(int x = 0;x < width;++x)
+	    {
+	      double value = !invalid_line[x] ? line[x] : 0.;
+	      column_sum[x] += value;
+	      column_sum2[x] += value * value;
+	      column_nb[x] += !invalid_line[x];
+	    }
+	}
+      if(leave >= 0)
+	{
+	  const T* line = data + leave * width;
+	  const unsigned char* invalid_line = &invalid[leave * width];
+	  for(int x = 0;x < width;++x)
+	    {
+	      double value = !invalid_line[x] ? line[x] : 0.;
+	      column_sum[x] -= value;
+	      column_sum2[x] -= value * value;
+	      column_nb[x] -= !invalid_line[x];
+	    }
+	}
+
+      double sum = 0.,sum2 = 0.;
+      int nb = 0;
+      for(int x = 0;x < std::min(half,width);++x)
+	sum += column_sum[x],sum2 += column_sum2[x],nb += column_nb[x];
+
+      const T* line = data + y * width;
+      const unsigned char* invalid_line = &invalid[y * width];
+      unsigned char* strong_line = &strong[y * width];
+      for(int x = 0;x < width;++x)
+	{
+	  int enter_x = x + half,leave_x = x - half - 1;
+	  if(enter_x < width)
+	    sum += column_sum[enter_x],sum2 += column_sum2[enter_x],nb += column_nb[enter_x];
+	  if(leave_x >= 0)
+	    sum -= column_sum[leave_x],sum2 -= column_sum2[leave_x],nb -= column_nb[leave_x];
+
+	  T raw = line[x];
+	  if(invalid_line[x] || raw < min_count || nb < 2)
+	    {
+	      strong_line[x] = 0;
+	      continue;
+	    }
+	  double mean = sum / nb;
+	  double variance = std::max(sum2 / nb - mean * mean,0.) * nb / (nb - 1);
+	  double dispersion_threshold = 1. + sigma_background * sqrt(2. / (nb - 1));
+	  strong_line[x] = (raw > mean + sigma_threshold * sqrt(mean) &&
+			    variance > dispersion_threshold * mean);
+	}
+    }
+}
+
+/** count the 8-connected groups of at least min_pixels strong pixels.
+ *  strong is cleared while groups are flood filled.
+ */
+int SpotFinder::_count_peaks(std::vector<unsigned char>& strong,int width,int height) const
+{
+  int nb_peaks = 0;
+  std::vector<int> stack;
+  for(int i = 0;i < width * height;++i)
+    {
+      if(!strong[i]) continue;
+      int nb_pixels = 0;
+      strong[i] = 0;
+      stack.push_back(i);
+      while(!stack.empty())
+	{
+	  int pixel = stack.back();
+	  stack.pop_back();
+	  ++nb_pixels;
+	  int x = pixel % width,y = pixel / width;
+	  for(int ny = std::max(y - 1,0);ny <= std::min(y + 1,height - 1);++ny)
+	    for(int nx = std::max(x - 1,0);nx <= std::min(x + 1,width - 1);++nx)
+	      {
+		int neighbour = ny * width + nx;
+		if(strong[neighbour])
+		  {
+		    strong[neighbour] = 0;
+		    stack.push_back(neighbour);
+		  }
+	      }
+	}
+      nb_peaks += nb_pixels >= m_parameters.min_pixels;
+    }
+  return nb_peaks;
+}
+
+/** @return the number of peaks of the frame, -1 if the depth is not managed
+ */
+int SpotFinder::findSpots(const void* data,int depth,int width,int height,
+			  unsigned int saturated,const unsigned char* masked) const
+{
+  DEB_MEMBER_FUNCT();
+  std::vector<unsigned char> strong(width * height);
+  if(depth == 2)
+    _strong_pixels((const unsigned short*)data,width,height,
+		   (unsigned short)saturated,masked,strong);
+  else if(depth == 4)
+    _strong_pixels((const unsigned int*)data,width,height,saturated,masked,strong);
+  else
+    return -1;
+  return _count_peaks(strong,width,height);
+}
@@ -0,0 +1,66 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERSPOTFINDER_H
+#define EIGERSPOTFINDER_H
+
+#include <vector>
+
+#include "lima/Debug.h"
+
+#include "EigerCamera.h"
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** Bragg spot finding on decompressed frames.
+     *
+     *  a pixel is strong if it is above min_count and above the local
+     *  background (mean + sigma_threshold * sqrt(mean) of the surrounding box),
+     *  and if the box is not just Poisson noise: its index of dispersion
+     *  (variance / mean) is above 1 + sigma_background * sqrt(2 / (n - 1)).
+     *  peaks are the 8-connected groups of at least min_pixels strong pixels.
+     */
+    class SpotFinder
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"SpotFinder","Eiger");
+    public:
+      SpotFinder();
+
+      void setParameters(const Camera::SpotFindingParameters&);
+      const Camera::SpotFindingParameters& getParameters() const {return m_parameters;}
+
+      int findSpots(const void* data,int depth,int width,int height,
+		    unsigned int saturated,const unsigned char* masked = NULL) const;
+      bool isHit(int nb_peaks) const {return nb_peaks >= m_parameters.hit_threshold;}
+    private:
+      template<class T>
+      void _strong_pixels(const T* data,int width,int height,
+			  T saturated,const unsigned char* masked,
+			  std::vector<unsigned char>& strong) const;
+      int _count_peaks(std::vector<unsigned char>& strong,int width,int height) const;
+
+      Camera::SpotFindingParameters m_parameters;
+    };
+  }
+}
+#endif	// EIGERSPOTFINDER_H
@@ -0,0 +1,157 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+
+#include <json/json.h>
+
+#include "lima/Exceptions.h"
+#include "EigerStartupCache.h"
+
+using namespace lima;
+using namespace lima::Eiger;
+
+static const int STARTUP_CACHE_VERSION = 1;
+
+StartupCache::Values::Values() :
+  x_pixel_size(0.),
+  y_pixel_size(0.),
+  width(0),
+  height(0),
+  readout_time(0.),
+  min_frame_time(0.),
+  bit_depth_readout(0),
+  auto_summation(false)
+{
+}
+
+bool StartupCache::Values::operator==(const Values& o) const
+{
+  return (detector_number == o.detector_number &&
+	  software_version == o.software_version &&
+	  api_version == o.api_version &&
+	  description == o.description &&
+	  x_pixel_size == o.x_pixel_size &&
+	  y_pixel_size == o.y_pixel_size &&
+	  width == o.width && height == o.height &&
+	  readout_time == o.readout_time &&
+	  min_frame_time == o.min_frame_time &&
+	  bit_depth_readout == o.bit_depth_readout &&
+	  auto_summation == o.auto_summation);
+}
+
+StartupCache::StartupCache(const std::string& directory,
+			   const std::string& detector_ip) :
+  m_filename(directory + "/eiger_" + detector_ip + ".json")
+{
+}
+
+/** @return false if there is no usable cache file
+ */
+bool StartupCache::load(Values& values) const
+{
+  DEB_MEMBER_FUNCT();
+  std::ifstream file(m_filename.c_str());
+  if(!file)
+    return false;
+
+  Json::Value root;
+  Json::Reader reader;
+  if(!reader.parse(file,root) || !root.isObject() ||
+     root.get("version",0).asInt() != STARTUP_CACHE_VERSION)
+    {
+      DEB_WARNING() << "Ignoring invalid startup cache " << m_filename;
+      return false;
+    }
+
+  values.detector_number = root.get("detector_number","").asString();
+  values.software_version = root.get("software_version","").asString();
+  values.api_version = root.get("api_version","").asString();
+  values.description = root.get("description","").asString();
+  values.x_pixel_size = root.get("x_pixel_size",0.).asDouble();
+  values.y_pixel_size = root.get("y_pixel_size",0.).asDouble();
+  values.width = root.get("width",0).asUInt();
+  values.height = root.get("height",0).asUInt();
+  values.readout_time = root.get("readout_time",0.).asDouble();
+  values.min_frame_time = root.get("min_frame_time",0.).asDouble();
+  values.bit_depth_readout = root.get("bit_depth_readout",0).asInt();
+  values.auto_summation = root.get("auto_summation",false).asBool();
+
+  if(values.api_version.empty() || !values.width || !values.height)
+    {
+      DEB_WARNING() << "Ignoring incomplete startup cache " << m_filename;
+      return false;
+    }
+  DEB_TRACE() << "Startup cache loaded from " << m_filename;
+  return true;
+}
+
+/** write a temporary file then rename it, a concurrent load never
+ *  sees a partial file. A failure is only reported.
+ */
+void StartupCache::save(const Values& values) const
+{
+  DEB_MEMBER_FUNCT();
+  Json::Value root;
+  root["version"] = STARTUP_CACHE_VERSION;
+  root["detector_number"] = values.detector_number;
+  root["software_version"] = values.software_version;
+  root["api_version"] = values.api_version;
+  root["description"] = values.description;
+  root["x_pixel_size"] = values.x_pixel_size;
+  root["y_pixel_size"] = values.y_pixel_size;
+  root["width"] = values.width;
+  root["height"] = values.height;
+  root["readout_time"] = values.readout_time;
+  root["min_frame_time"] = values.min_frame_time;
+  root["bit_depth_readout"] = values.bit_depth_readout;
+  root["auto_summation"] = values.auto_summation;
+
+  std::ostringstream tmp_filename;
+  tmp_filename << m_filename << '.' << getpid();
+  {
+    std::ofstream file(tmp_filename.str().c_str());
+    Json::StyledWriter writer;
+    file << writer.write(root);
+    if(!file)
+      {
+	DEB_WARNING() << "Can't write startup cache " << tmp_filename.str();
+	unlink(tmp_filename.str().c_str());
+	return;
+      }
+  }
+  if(rename(tmp_filename.str().c_str(),m_filename.c_str()))
+    {
+      DEB_WARNING() << "Can't write startup cache " << m_filename
+		    << ": " << strerror(errno);
+      unlink(tmp_filename.str().c_str());
+    }
+}
+
+void StartupCache::remove() const
+{
+  unlink(m_filename.c_str());
+}
@@ -0,0 +1,76 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef EIGERSTARTUPCACHE_H
+#define EIGERSTARTUPCACHE_H
+
+#include <string>
+
+#include "lima/Debug.h"
+
+namespace lima
+{
+  namespace Eiger
+  {
+    /** On-disk cache of the detector description read at Camera construction.
+     *
+     *  one json file per detector address in the cache directory. The values
+     *  are valid for the detector number, firmware (software_version) and api
+     *  version they were read with, which the Camera checks in the
+     *  background after a construction from the cache.
+     */
+    class StartupCache
+    {
+      DEB_CLASS_NAMESPC(DebModCamera,"StartupCache","Eiger");
+    public:
+      struct Values
+      {
+	Values();
+	bool operator==(const Values&) const;
+	bool operator!=(const Values& o) const {return !(*this == o);}
+
+	std::string	detector_number;
+	std::string	software_version;
+	std::string	api_version;
+	std::string	description;
+	double		x_pixel_size;
+	double		y_pixel_size;
+	unsigned int	width;
+	unsigned int	height;
+	double		readout_time;
+	double		min_frame_time;
+	int		bit_depth_readout;
+	bool		auto_summation;
+      };
+
+      StartupCache(const std::string& directory,const std::string& detector_ip);
+
+      bool load(Values&) const;
+      void save(const Values&) const;
+      void remove() const;
+
+      const std::string& getFilename() const {return m_filename;}
+    private:
+      std::string	m_filename;
+    };
+  }
+}
+#endif	// EIGERSTARTUPCACHE_H
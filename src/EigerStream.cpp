@@ -21,11 +21,17 @@
 //###########################################################################
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
 
+#include <algorithm>
 #include <map>
 #include <set>
+#include <sstream>
+#include <list>
 
 #include <zmq.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include <json/json.h>
 
@@ -34,6 +40,15 @@
 
 #include "lima/Exceptions.h"
 #include "EigerStream.h"
+#include "EigerFrameRing.h"
+#include "EigerAzimuthalIntegrator.h"
+#include "EigerSpotFinder.h"
+#include "EigerRecompress.h"
+#include "EigerRawDump.h"
+
+#include "processlib/Data.h"
+#include "processlib/LinkTask.h"
+#include "processlib/ProcessExceptions.h"
 
 using namespace lima;
 using namespace lima::Eiger;
@@ -58,11 +73,28 @@ class Stream::_BufferCallback : public HwBufferCtrlObj::Callback
 {
   DEB_CLASS_NAMESPC(DebModCamera,"Stream","_BufferCallback");
   typedef std::pair<std::shared_ptr<Stream::Message>,int> MessageNDepth;
-  typedef std::map<void*,MessageNDepth> Data2Message;
+  // with software summation, a buffer is built from several messages
+  typedef std::vector<MessageNDepth> MessageList;
+  typedef std::map<void*,MessageList> Data2Message;
   typedef std::multiset<void *> BufferList;
+  struct HistoryEntry
+  {
+    MessageList		messages;
+    Timestamp		timestamp;
+  };
+  typedef std::map<int,HistoryEntry> History;
 public:
-  _BufferCallback() : HwBufferCtrlObj::Callback() {}
-  virtual ~_BufferCallback() {releaseAll();}
+  _BufferCallback(Stream& stream) : HwBufferCtrlObj::Callback(),
+				    m_stream(stream),
+				    m_history_max_size(0),
+				    m_history_nb_frames(0),
+				    m_history_size(0) {}
+  virtual ~_BufferCallback()
+  {
+    AutoMutex lock(m_mutex);
+    m_buffer_in_use.clear();
+    m_data_2_msg.clear();
+  }
 
   virtual void map(void* address)
   {
@@ -72,75 +104,623 @@ public:
     AutoMutex lock(m_mutex);
     m_buffer_in_use.insert(address);
   }
-  virtual void release(void* address)
+  virtual void release(void* address);
+  virtual void releaseAll();
+  
+  /** register a new message for a buffer.
+   *  first_msg start a new message list for this buffer
+   *  (always true without software summation).
+   */
+  void register_new_msg(std::shared_ptr<Stream::Message>& msg,void* aDataBuffer,int depth,
+			int frameid,Timestamp timestamp,bool first_msg = true)
   {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(address);
+    DEB_PARAM() << DEB_VAR3(aDataBuffer,frameid,first_msg);
 
     AutoMutex lock(m_mutex);
-    BufferList::iterator it = m_buffer_in_use.find(address);
-    if(it == m_buffer_in_use.end())
-      THROW_HW_ERROR(Error) << "Internal error: releasing buffer not in used list";
-    
-    m_buffer_in_use.erase(it++);
-    if(it == m_buffer_in_use.end() || *it != address)
-      m_data_2_msg.erase(address);
+    MessageList& messages = m_data_2_msg[aDataBuffer];
+    if(first_msg) messages.clear();
+    messages.push_back(MessageNDepth(msg,depth));
+    if(!m_history_max_size) return;
+
+    HistoryEntry& entry = m_history[frameid];
+    if(first_msg)
+      {
+	m_history_size -= _messages_size(entry.messages);
+	entry.messages.clear();
+	entry.timestamp = timestamp;
+      }
+    entry.messages.push_back(MessageNDepth(msg,depth));
+    m_history_size += zmq_msg_size(msg->get_msg());
+    // one compressed slot per Lima buffer, dropped when its buffer is
+    // reused or to stay into the memory budget
+    while(m_history.size() > 1 &&
+	  (m_history.begin()->first <= frameid - m_history_nb_frames ||
+	   m_history_size > m_history_max_size))
+      {
+	History::iterator oldest = m_history.begin();
+	m_history_size -= _messages_size(oldest->second.messages);
+	m_history.erase(oldest);
+      }
   }
-  virtual void releaseAll()
+  bool get_msg(void* aDataBuffer,void*& msg_data,size_t& msg_size,int& depth,
+	       int msg_index)
   {
     DEB_MEMBER_FUNCT();
-    
+    DEB_PARAM() << DEB_VAR2(aDataBuffer,msg_index);
+
     AutoMutex lock(m_mutex);
-    m_buffer_in_use.clear();
-    m_data_2_msg.clear();
+    Data2Message::iterator it = m_data_2_msg.find(aDataBuffer);
+    if(it == m_data_2_msg.end() || msg_index >= int(it->second.size()))
+      return false;
+    
+    _get_msg_info(it->second[msg_index],msg_data,msg_size,depth);
+    DEB_RETURN() << DEB_VAR2(msg_data,msg_size);
+    return true;
   }
-  
-  void register_new_msg(std::shared_ptr<Stream::Message>& msg,void* aDataBuffer,int depth)
+  bool get_history_msg(int frameid,int msg_index,std::shared_ptr<Stream::Message>& message,
+		       void*& msg_data,size_t& msg_size,int& depth,
+		       Timestamp& timestamp)
   {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(aDataBuffer);
+    DEB_PARAM() << DEB_VAR2(frameid,msg_index);
 
     AutoMutex lock(m_mutex);
-    m_data_2_msg[aDataBuffer] = MessageNDepth(msg,depth);
+    History::iterator it = m_history.find(frameid);
+    if(it == m_history.end() || msg_index >= int(it->second.messages.size()))
+      return false;
+
+    MessageNDepth& message_depth = it->second.messages[msg_index];
+    message = message_depth.first;
+    timestamp = it->second.timestamp;
+    _get_msg_info(message_depth,msg_data,msg_size,depth);
+    DEB_RETURN() << DEB_VAR2(msg_data,msg_size);
+    return true;
   }
-  bool get_msg(void* aDataBuffer,void*& msg_data,size_t& msg_size,int& depth)
+  /** keep the compressed messages of the last nb_frames frames
+   *  within max_size bytes, no history if max_size is null
+   */
+  void set_history(long long max_size,int nb_frames)
   {
     DEB_MEMBER_FUNCT();
-    DEB_PARAM() << DEB_VAR1(aDataBuffer);
+    DEB_PARAM() << DEB_VAR2(max_size,nb_frames);
 
     AutoMutex lock(m_mutex);
-    Data2Message::iterator it = m_data_2_msg.find(aDataBuffer);
-    if(it == m_data_2_msg.end())
-      return false;
-    
-    MessageNDepth message_depth = it->second;
+    m_history_max_size = max_size;
+    m_history_nb_frames = nb_frames;
+    m_history.clear(),m_history_size = 0;
+  }
+  bool is_in_use(void* address)
+  {
+    AutoMutex lock(m_mutex);
+    return m_buffer_in_use.find(address) != m_buffer_in_use.end();
+  }
+private:
+  static long long _messages_size(const MessageList& messages)
+  {
+    long long size = 0;
+    for(MessageList::const_iterator i = messages.begin();i != messages.end();++i)
+      size += zmq_msg_size(i->first->get_msg());
+    return size;
+  }
+  void _get_msg_info(MessageNDepth& message_depth,
+		     void*& msg_data,size_t& msg_size,int& depth)
+  {
     std::shared_ptr<Stream::Message> message = message_depth.first;
     depth = message_depth.second;
     msg_data = zmq_msg_data(message->get_msg());
     msg_size = zmq_msg_size(message->get_msg());
-    DEB_RETURN() << DEB_VAR2(msg_data,msg_size);
-    return true;
   }
-private:
+
+  Stream& m_stream;
   Mutex m_mutex;
   Data2Message m_data_2_msg;
   BufferList m_buffer_in_use;
+  History m_history;
+  long long m_history_max_size;
+  int m_history_nb_frames;
+  long long m_history_size;
 };
 //		      --- buffer management ---
+/* With compressed slots (Camera::setCompressedHistoryMemory), Lima gets
+ * as many buffers as compressed frames fit into the memory budget but
+ * only NB_DECOMPRESSED_BUFFERS buffers are allocated: the other slots
+ * only hold the compressed stream messages. Frames out of the allocated
+ * buffers are lazily decompressed into a small LRU of private buffers,
+ * an entry given by getFrameInfo is pinned until Lima releases it
+ * (buffer callback release), getFramePtr only gives the Lima buffers.
+ */
 class Stream::_BufferCtrlObj : public SoftBufferCtrlObj
 {
   DEB_CLASS_NAMESPC(DebModCamera,"Stream","_BufferCtrlObj");
+  static const int WORKING_SET_SIZE = 4;
+  static const int NB_DECOMPRESSED_BUFFERS = 16;
+  // before the first compression statistics
+  static const int DEFAULT_COMPRESSION_RATIO = 5;
+  struct _WorkingFrame
+  {
+    int		acq_frame_nb;
+    void*	ptr;
+    Timestamp	timestamp;
+    int		nb_users;
+  };
+  typedef std::list<_WorkingFrame> WorkingSet;
 public:
   _BufferCtrlObj(Stream& stream) : 
-    m_stream(stream)
+    m_stream(stream),
+    m_compressed_slots(false),
+    m_nb_slots(0),
+    m_last_frame(-1),
+    m_working_frame_size(0)
   {
   }
+  virtual ~_BufferCtrlObj()
+  {
+    _free_all();
+  }
   virtual HwBufferCtrlObj::Callback* getBufferCallback()
   {
     return m_stream.m_buffer_cbk;
   }
+  virtual void getMaxNbBuffers(int& max_nb_buffers)
+  {
+    DEB_MEMBER_FUNCT();
+    int history_memory;
+    m_stream.m_cam.getCompressedHistoryMemory(history_memory);
+    if(!history_memory)
+      {
+	SoftBufferCtrlObj::getMaxNbBuffers(max_nb_buffers);
+	return;
+      }
+    FrameDim frame_dim;
+    getFrameDim(frame_dim);
+    Camera::CompressionStatistics statistics;
+    m_stream.m_cam.getCompressionStatistics(statistics);
+    double ratio = statistics.mean_ratio > 1. ?
+      statistics.mean_ratio : DEFAULT_COMPRESSION_RATIO;
+    double nb_slots = history_memory * 1024. * 1024. * ratio / frame_dim.getMemSize();
+    max_nb_buffers = std::max(int(nb_slots),NB_DECOMPRESSED_BUFFERS);
+    DEB_RETURN() << DEB_VAR2(ratio,max_nb_buffers);
+  }
+  virtual void setNbBuffers(int nb_buffers)
+  {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_buffers);
+    int history_memory;
+    m_stream.m_cam.getCompressedHistoryMemory(history_memory);
+    bool compressed_slots = history_memory > 0 && nb_buffers > NB_DECOMPRESSED_BUFFERS;
+    SoftBufferCtrlObj::setNbBuffers(compressed_slots ? NB_DECOMPRESSED_BUFFERS : nb_buffers);
+
+    AutoMutex lock(m_mutex);
+    m_compressed_slots = compressed_slots;
+    m_nb_slots = nb_buffers;
+    DEB_TRACE() << DEB_VAR1(m_compressed_slots);
+  }
+  virtual void getNbBuffers(int& nb_buffers)
+  {
+    AutoMutex lock(m_mutex);
+    if(m_compressed_slots)
+      nb_buffers = m_nb_slots;
+    else
+      SoftBufferCtrlObj::getNbBuffers(nb_buffers);
+  }
+  virtual void* getBufferPtr(int buffer_nb,int concat_frame_nb = 0)
+  {
+    AutoMutex lock(m_mutex);
+    if(m_compressed_slots)
+      buffer_nb %= NB_DECOMPRESSED_BUFFERS;
+    lock.unlock();
+    return SoftBufferCtrlObj::getBufferPtr(buffer_nb,concat_frame_nb);
+  }
+  virtual void getFrameInfo(int acq_frame_nb,HwFrameInfoType& info)
+  {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+
+    AutoMutex lock(m_mutex);
+    if(m_compressed_slots && acq_frame_nb > m_last_frame)
+      THROW_HW_ERROR(Error) << "Frame " << acq_frame_nb << " not yet available";
+    // only the last NB_DECOMPRESSED_BUFFERS frames are in a Lima buffer
+    bool in_lima_buffer = !m_compressed_slots ||
+      acq_frame_nb > m_last_frame - NB_DECOMPRESSED_BUFFERS;
+    if(in_lima_buffer)
+      {
+	lock.unlock();
+	SoftBufferCtrlObj::getFrameInfo(acq_frame_nb,info);
+	if(info.acq_frame_nb == acq_frame_nb)
+	  return;
+	// the buffer was reused meanwhile
+	lock.lock();
+	if(!m_compressed_slots)
+	  THROW_HW_ERROR(Error) << "Frame " << acq_frame_nb << " no more available";
+      }
+    _WorkingFrame& frame = _get_from_history(acq_frame_nb);
+    ++frame.nb_users;
+    info = HwFrameInfoType(acq_frame_nb,frame.ptr,&m_working_frame_dim,
+			   frame.timestamp,0);
+  }
+  /** a new acquisition, the compressed slots are emptied
+   */
+  void prepare()
+  {
+    DEB_MEMBER_FUNCT();
+    int history_memory;
+    m_stream.m_cam.getCompressedHistoryMemory(history_memory);
+
+    AutoMutex lock(m_mutex);
+    _clear_working_set();
+    m_last_frame = -1;
+    m_stream.m_buffer_cbk->set_history(m_compressed_slots ?
+				       history_memory * 1024LL * 1024LL : 0,
+				       m_nb_slots);
+  }
+  /** give a frame to Lima, it's the last one
+   */
+  bool newFrameReady(HwFrameInfoType& frame_info)
+  {
+    {
+      AutoMutex lock(m_mutex);
+      m_last_frame = frame_info.acq_frame_nb;
+    }
+    return getBuffer().newFrameReady(frame_info);
+  }
+  /** @return false if the Lima buffer of this new frame is still used
+   *  by Lima for an older frame: Lima only knows the compressed slots
+   *  so it can't detect this overrun
+   */
+  bool isBufferFree(int acq_frame_nb)
+  {
+    AutoMutex lock(m_mutex);
+    if(!m_compressed_slots) return true;
+    lock.unlock();
+    void* ptr = getBuffer().getFrameBufferPtr(acq_frame_nb);
+    return !m_stream.m_buffer_cbk->is_in_use(ptr);
+  }
+  /** a working set frame is no more used by Lima,
+   *  released frames out of the working set are freed
+   */
+  void releaseWorkingFrame(void* ptr)
+  {
+    AutoMutex lock(m_mutex);
+    for(WorkingSet::iterator i = m_working_set.begin();i != m_working_set.end();++i)
+      if(i->ptr == ptr && i->nb_users > 0)
+	--i->nb_users;
+    for(WorkingSet::iterator i = m_released.begin();i != m_released.end();)
+      {
+	if(i->ptr == ptr && i->nb_users > 0)
+	  --i->nb_users;
+	if(!i->nb_users)
+	  free(i->ptr),i = m_released.erase(i);
+	else
+	  ++i;
+      }
+  }
+  /** Lima released all its buffers
+   */
+  void releaseAllWorkingFrames()
+  {
+    AutoMutex lock(m_mutex);
+    for(WorkingSet::iterator i = m_working_set.begin();i != m_working_set.end();++i)
+      i->nb_users = 0;
+    for(WorkingSet::iterator i = m_released.begin();i != m_released.end();++i)
+      free(i->ptr);
+    m_released.clear();
+  }
 private:
+  _WorkingFrame& _get_from_history(int acq_frame_nb)
+  {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(acq_frame_nb);
+
+    for(WorkingSet::iterator i = m_working_set.begin();
+	i != m_working_set.end();++i)
+      {
+	if(i->acq_frame_nb == acq_frame_nb)
+	  {
+	    m_working_set.splice(m_working_set.begin(),m_working_set,i);
+	    return m_working_set.front();
+	  }
+      }
+
+    // keep the messages alive while decompressing
+    std::vector<std::shared_ptr<Stream::Message> > history_messages;
+    Decompress::MessageList messages;
+    Decompress::Message message;
+    Timestamp timestamp;
+    std::shared_ptr<Stream::Message> history_message;
+    while(m_stream.m_buffer_cbk->get_history_msg(acq_frame_nb,messages.size(),
+						 history_message,
+						 message.data,message.size,message.depth,
+						 timestamp))
+      {
+	history_messages.push_back(history_message);
+	messages.push_back(message);
+      }
+    if(messages.empty())
+      THROW_HW_ERROR(Error) << "Frame " << acq_frame_nb << " no more available";
+
+    FrameDim frame_dim;
+    getFrameDim(frame_dim);
+    int frame_size = frame_dim.getMemSize();
+    if(frame_size != m_working_frame_size)
+      {
+	_clear_working_set();
+	m_working_frame_size = frame_size;
+      }
+    m_working_frame_dim = frame_dim;
+
+    // recycle the least recently used frame not used by Lima
+    _WorkingFrame frame;
+    WorkingSet::iterator unused = m_working_set.end();
+    if(int(m_working_set.size()) >= WORKING_SET_SIZE)
+      for(WorkingSet::iterator i = m_working_set.begin();i != m_working_set.end();++i)
+	if(!i->nb_users) unused = i;
+    if(unused != m_working_set.end())
+      {
+	frame.ptr = unused->ptr;
+	m_working_set.erase(unused);
+      }
+    else if(posix_memalign(&frame.ptr,16,frame_size))
+      THROW_HW_ERROR(Error) << "Can't allocate working set buffer";
+    frame.nb_users = 0;
+    frame.acq_frame_nb = acq_frame_nb;
+    frame.timestamp = timestamp;
+    m_working_set.push_front(frame);
+    // back to the working set size once the pinned frames are released
+    for(WorkingSet::iterator i = --m_working_set.end();
+	int(m_working_set.size()) > WORKING_SET_SIZE && i != m_working_set.begin();)
+      {
+	WorkingSet::iterator prev = i;--prev;
+	if(!i->nb_users)
+	  free(i->ptr),m_working_set.erase(i);
+	i = prev;
+      }
+
+    std::shared_ptr<const Decompress::PixelMask> pixel_mask = m_stream.get_pixel_mask();
+    Size full_frame_size;
+    Roi roi;
+    m_stream.get_roi(full_frame_size,roi);
+    int return_code = Decompress::decompressFrames(messages,frame.ptr,frame_size,
+						   frame_dim.getDepth(),
+						   full_frame_size,roi,
+						   pixel_mask.get(),NULL,
+						   m_stream.get_saturated_value());
+    if(return_code < 0)
+      {
+	m_working_set.front().acq_frame_nb = -1;
+	THROW_HW_ERROR(Error) << "Decompression of frame " << acq_frame_nb
+			      << " failed (error code: " << return_code << ")";
+      }
+    return m_working_set.front();
+  }
+  /** frames still used by Lima are only freed when released
+   */
+  void _clear_working_set()
+  {
+    for(WorkingSet::iterator i = m_working_set.begin();
+	i != m_working_set.end();++i)
+      {
+	if(i->nb_users)
+	  m_released.push_back(*i);
+	else
+	  free(i->ptr);
+      }
+    m_working_set.clear();
+  }
+  void _free_all()
+  {
+    _clear_working_set();
+    for(WorkingSet::iterator i = m_released.begin();i != m_released.end();++i)
+      free(i->ptr);
+    m_released.clear();
+  }
+
   Stream&	m_stream;
+  Mutex		m_mutex;
+  bool		m_compressed_slots;
+  int		m_nb_slots;
+  int		m_last_frame;
+  WorkingSet	m_working_set;
+  WorkingSet	m_released;
+  FrameDim	m_working_frame_dim;
+  int		m_working_frame_size;
+};
+
+void Stream::_BufferCallback::release(void* address)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(address);
+
+  AutoMutex lock(m_mutex);
+  BufferList::iterator it = m_buffer_in_use.find(address);
+  if(it == m_buffer_in_use.end())
+    THROW_HW_ERROR(Error) << "Internal error: releasing buffer not in used list";
+
+  m_buffer_in_use.erase(it++);
+  if(it == m_buffer_in_use.end() || *it != address)
+    m_data_2_msg.erase(address);
+  lock.unlock();
+  m_stream.m_buffer_ctrl_obj->releaseWorkingFrame(address);
+}
+
+void Stream::_BufferCallback::releaseAll()
+{
+  DEB_MEMBER_FUNCT();
+
+  AutoMutex lock(m_mutex);
+  m_buffer_in_use.clear();
+  m_data_2_msg.clear();
+  lock.unlock();
+  m_stream.m_buffer_ctrl_obj->releaseAllWorkingFrames();
+}
+
+//		       --- Decompression pool ---
+/** plugin owned threads decompressing the received frames,
+ *  see Camera::setDecompressionPlacement
+ */
+class Stream::_DecompressPool
+{
+  DEB_CLASS_NAMESPC(DebModCamera,"Stream::_DecompressPool","Eiger");
+public:
+  _DecompressPool(Stream& stream) :
+    m_stream(stream),
+    m_stop(false),
+    m_cpu_mask(0),
+    m_nb_busy(0),
+    m_publishing(false),
+    m_next_frame(0),
+    m_stopped(false)
+  {
+  }
+  ~_DecompressPool()
+  {
+    _stop_threads();
+  }
+  void setParameters(int nb_threads,unsigned long long cpu_mask)
+  {
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(nb_threads,cpu_mask);
+    if(int(m_threads.size()) == nb_threads && m_cpu_mask == cpu_mask)
+      return;
+
+    _stop_threads();
+    AutoMutex lock(m_cond.mutex());
+    m_stop = false;
+    m_cpu_mask = cpu_mask;
+    m_threads.resize(nb_threads);
+    for(int i = 0;i < nb_threads;++i)
+      {
+	pthread_create(&m_threads[i],NULL,_runFunc,this);
+	if(!cpu_mask) continue;
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	for(int cpu = 0;cpu < 64;++cpu)
+	  if(cpu_mask & (1ULL << cpu))
+	    CPU_SET(cpu,&cpu_set);
+	if(pthread_setaffinity_np(m_threads[i],sizeof(cpu_set),&cpu_set))
+	  DEB_WARNING() << "Can't pin decompression thread on " << DEB_VAR1(cpu_mask);
+      }
+  }
+  /** clear the frames of the previous acquisition,
+   *  frames being decompressed are waited for
+   */
+  void clear()
+  {
+    AutoMutex lock(m_cond.mutex());
+    m_frames.clear();
+    while(m_nb_busy || m_publishing)
+      m_cond.wait();
+    m_decompressed.clear();
+    m_next_frame = 0;
+    m_stopped = false;
+  }
+  /** drop the queued frames, nothing more is given to Lima
+   */
+  void abort()
+  {
+    AutoMutex lock(m_cond.mutex());
+    m_frames.clear();
+    m_stopped = true;
+  }
+  /** @return false if the acquisition must stop (newFrameReady returned
+   *  false or a decompression failed)
+   */
+  bool push(int acq_frame_nb)
+  {
+    AutoMutex lock(m_cond.mutex());
+    if(m_stopped) return false;
+    m_frames.push_back(acq_frame_nb);
+    m_cond.signal();
+    return true;
+  }
+  /** the Lima buffer (and its compressed message) of acq_frame_nb is the one
+   *  of acq_frame_nb - nb_buffers, it must be published before it's reused
+   *  @return false on overrun
+   */
+  bool check_overrun(int acq_frame_nb,int nb_buffers)
+  {
+    AutoMutex lock(m_cond.mutex());
+    return acq_frame_nb - m_next_frame < nb_buffers;
+  }
+private:
+  static void* _runFunc(void* pool)
+  {
+    ((_DecompressPool*)pool)->_run();
+    return NULL;
+  }
+  void _run()
+  {
+    AutoMutex lock(m_cond.mutex());
+    while(1)
+      {
+	while(m_frames.empty() && !m_stop)
+	  m_cond.wait();
+	if(m_stop) break;
+
+	int acq_frame_nb = m_frames.front();
+	m_frames.pop_front();
+	++m_nb_busy;
+	lock.unlock();
+
+	bool vetoed;
+	bool ok = m_stream._decompress(acq_frame_nb,vetoed);
+
+	lock.lock();
+	--m_nb_busy;
+	if(!ok)
+	  m_stopped = true;
+	else if(!m_stopped)
+	  m_decompressed.insert(acq_frame_nb);
+	_publish(lock);
+	m_cond.broadcast();
+      }
+  }
+  /** frames are decompressed out of order, they are given to Lima in order.
+   *  only one thread publishes at a time, newFrameReady is called unlocked.
+   */
+  void _publish(AutoMutex& lock)
+  {
+    if(m_publishing) return;
+    m_publishing = true;
+    std::set<int>::iterator i;
+    while(!m_stopped &&
+	  (i = m_decompressed.begin()) != m_decompressed.end() && *i == m_next_frame)
+      {
+	m_decompressed.erase(i);
+	HwFrameInfoType frame_info;
+	frame_info.acq_frame_nb = m_next_frame;
+	lock.unlock();
+	bool continue_flag = m_stream.m_buffer_ctrl_obj->newFrameReady(frame_info);
+	lock.lock();
+	++m_next_frame;
+	if(!continue_flag)
+	  m_stopped = true;
+      }
+    m_publishing = false;
+  }
+  void _stop_threads()
+  {
+    AutoMutex lock(m_cond.mutex());
+    m_stop = true;
+    m_cond.broadcast();
+    lock.unlock();
+
+    for(std::vector<pthread_t>::iterator i = m_threads.begin();i != m_threads.end();++i)
+      pthread_join(*i,NULL);
+    m_threads.clear();
+  }
+
+  Stream&		m_stream;
+  Cond			m_cond;
+  bool			m_stop;
+  unsigned long long	m_cpu_mask;
+  std::vector<pthread_t> m_threads;
+  std::list<int>	m_frames;
+  int			m_nb_busy;
+  bool			m_publishing;
+  std::set<int>		m_decompressed;	///< waiting for the previous frames
+  int			m_next_frame;	///< next frame to give to Lima
+  bool			m_stopped;
 };
 
 //			 --- Stream class ---
@@ -148,12 +728,24 @@ Stream::Stream(Camera& cam) :
   m_cam(cam),
   m_active(false),
   m_header_detail(OFF),
+  m_sent_header_detail(OFF),
   m_dirty_flag(true),
   m_wait(true),
   m_running(false),
   m_stop(false),
-  m_buffer_cbk(new Stream::_BufferCallback()),
-  m_buffer_ctrl_obj(new Stream::_BufferCtrlObj(*this))
+  m_buffer_cbk(new Stream::_BufferCallback(*this)),
+  m_buffer_ctrl_obj(new Stream::_BufferCtrlObj(*this)),
+  m_apply_pixel_mask(false),
+  m_statistics_active(false),
+  m_sparse_threshold(0.),
+  m_azimuthal_integration_active(false),
+  m_spot_finding_active(false),
+  m_saturated_value(0xffffffff),
+  m_recompression_active(false),
+  m_decompress(NULL),
+  m_decompression_placement(Camera::PROCESSLIB),
+  m_decompress_pool(new Stream::_DecompressPool(*this)),
+  m_frame_offset(0)
 {
   DEB_CONSTRUCTOR();
 
@@ -178,18 +770,81 @@ Stream::~Stream()
   close(m_pipes[0]),close(m_pipes[1]);
   zmq_ctx_destroy(m_zmq_context);
 
+  delete m_decompress_pool;
   delete m_buffer_cbk;
   delete m_buffer_ctrl_obj;
 }
 
 void Stream::start()
 {
+  DEB_MEMBER_FUNCT();
+
+  m_buffer_ctrl_obj->prepare();
+
+  m_cam.getStatisticsActive(m_statistics_active);
+  m_cam.m_statistics->clear();
+
+  m_cam.getSparseThreshold(m_sparse_threshold);
+  int nb_bins;
+  m_cam.getAzimuthalIntegration(nb_bins);
+  m_azimuthal_integration_active = nb_bins > 0;
+  m_cam.m_azimuthal_integrator->clear();
+  Camera::SpotFindingParameters spot_finding;
+  m_cam.getSpotFinding(spot_finding);
+  m_cam.m_spot_finder->setParameters(spot_finding);
+  m_cam.m_nb_peaks->clear();
+  m_cam.m_compressed_sizes->clear();
+  m_spot_finding_active = spot_finding.active;
+  m_cam.getSoftwareRoi(m_roi);
+  int saturated_value;
+  m_cam.getSaturatedPixelValue(saturated_value);
+  m_saturated_value = saturated_value;
+  m_cam.getRecompression(m_recompression_active);
+  if(m_recompression_active)
+    {
+      Camera::CompressionType recompression_type;
+      m_cam.getRecompressionType(recompression_type);
+      int nb_threads;
+      m_cam.getRecompressionNbThreads(nb_threads);
+      m_cam.m_recompress->setParameters(recompression_type,nb_threads);
+    }
+  m_cam.getDecompressionPlacement(m_decompression_placement);
+  if(m_decompression_placement == Camera::DEDICATED_POOL)
+    {
+      int nb_threads;
+      unsigned long long cpu_mask;
+      m_cam.getDecompressionPool(nb_threads,cpu_mask);
+      m_decompress_pool->setParameters(nb_threads,cpu_mask);
+      m_decompress_pool->clear();
+    }
+  m_frame_size = Size(m_cam.m_maxImageWidth,m_cam.m_maxImageHeight);
+  {
+    AutoMutex mask_lock(m_pixel_mask_mutex);
+    if(m_pixel_mask &&
+       m_pixel_mask->m_nb_pixels != m_frame_size.getWidth() * m_frame_size.getHeight())
+      {
+	DEB_WARNING() << "Pixel mask dropped, it doesn't match the frame size "
+		      << DEB_VAR1(m_frame_size);
+	m_pixel_mask.reset();
+      }
+    else if(m_pixel_mask && !m_pixel_mask->isMaskedBuilt(m_frame_size,m_roi))
+      {
+	std::shared_ptr<Decompress::PixelMask> pixel_mask(new Decompress::PixelMask(*m_pixel_mask));
+	pixel_mask->buildMasked(m_frame_size,m_roi);
+	m_pixel_mask = pixel_mask;
+      }
+  }
+  // a re-triggered series goes on with its frame numbers
+  m_frame_offset = m_cam.m_armed_frame_offset;
+  m_cam.m_nb_vetoed_frames = 0;
+
   m_buffer_ctrl_obj->getBuffer().setStartTimestamp(Timestamp::now());
 }
 
 void Stream::stop()
 {
   setActive(false);
+  m_decompress_pool->abort();
 
   AutoMutex aLock(m_cond.mutex());
   m_wait = true;
@@ -231,13 +886,26 @@ void Stream::setActive(bool active)
   DEB_MEMBER_FUNCT();
   DEB_PARAM() << DEB_VAR1(active);
 
+  bool software_pixel_mask;
+  m_cam.getSoftwarePixelMask(software_pixel_mask);
+
+  AutoMutex mask_lock(m_pixel_mask_mutex);
+  // new detector mask (pixel mask setter, initialization): read it again
+  if(m_cam.m_pixel_mask_changed.exchange(false))
+    m_pixel_mask.reset();
+  m_apply_pixel_mask = software_pixel_mask;
+  // the detector pixel mask is only sent with the "all" header detail
+  bool need_pixel_mask = software_pixel_mask && !m_pixel_mask;
+  mask_lock.unlock();
+
   AutoMutex lock(m_cond.mutex());
+  HeaderDetail header_detail = need_pixel_mask ? ALL : m_header_detail;
   //Don't resend parameters if not changed
-  if(active != m_active || m_dirty_flag)
+  if(active != m_active || m_dirty_flag || header_detail != m_sent_header_detail)
     {
 
       const char* header_detail_str;
-      switch(m_header_detail)
+      switch(header_detail)
 	{
 	case ALL:
 	  header_detail_str = "all";break;
@@ -251,12 +919,14 @@ void Stream::setActive(bool active)
 	m_cam.m_requests->set_param(Requests::STREAM_HEADER_DETAIL,header_detail_str);
       DEB_TRACE() << "STREAM_HEADER_DETAIL:" << DEB_VAR1(header_detail_str);
       header_detail_req->wait();
+      m_sent_header_detail = header_detail;
 
       const char* active_str = active ? "enabled" : "disabled";
       std::shared_ptr<Requests::Param> active_req = 
 	m_cam.m_requests->set_param(Requests::STREAM_MODE,active_str);
       DEB_TRACE() << "STREAM_MODE:" << DEB_VAR1(active_str);
       active_req->wait();
+      m_cam._config_changed();
     }
   m_active = active,m_dirty_flag = false;
 
@@ -275,9 +945,18 @@ HwBufferCtrlObj* Stream::getBufferCtrlObj()
   return m_buffer_ctrl_obj;
 }
 
-bool Stream::get_msg(void* aDataBuffer,void*& msg_data,size_t& msg_size,int &depth)
+bool Stream::get_msg(void* aDataBuffer,void*& msg_data,size_t& msg_size,int &depth,
+		     int msg_index)
+{
+  return m_buffer_cbk->get_msg(aDataBuffer,msg_data,msg_size,depth,msg_index);
+}
+
+std::shared_ptr<const Decompress::PixelMask> Stream::get_pixel_mask()
 {
-  return m_buffer_cbk->get_msg(aDataBuffer,msg_data,msg_size,depth);
+  AutoMutex lock(m_pixel_mask_mutex);
+  if(!m_apply_pixel_mask)
+    return std::shared_ptr<const Decompress::PixelMask>();
+  return m_pixel_mask;
 }
 
 void* Stream::_runFunc(void *streamPt)
@@ -336,6 +1015,195 @@ static bool _get_header(const Json::Value& stream_header,
 }
 #endif
 
+FrameRing<Camera::FrameStatistics>* Stream::get_statistics()
+{
+  return m_statistics_active ? m_cam.m_statistics : NULL;
+}
+
+AzimuthalIntegrator* Stream::get_azimuthal_integrator()
+{
+  return m_azimuthal_integration_active ? m_cam.m_azimuthal_integrator : NULL;
+}
+
+SpotFinder* Stream::get_spot_finder()
+{
+  return m_spot_finding_active ? m_cam.m_spot_finder : NULL;
+}
+
+Recompress* Stream::get_recompress()
+{
+  return m_recompression_active ? m_cam.m_recompress : NULL;
+}
+
+void Stream::setDecompress(Decompress* decompress)
+{
+  m_decompress = decompress;
+}
+
+/** a Lima frame is received, it's decompressed here (receive thread),
+ *  by the decompression pool or by processlib after newFrameReady
+ */
+bool Stream::_frame_ready(HwFrameInfoType& frame_info)
+{
+  switch(m_decompression_placement)
+    {
+    case Camera::RECEIVE_THREAD:
+      {
+	bool vetoed;
+	if(!_decompress(frame_info.acq_frame_nb,vetoed))
+	  return false;
+	// its Lima buffer is reused by the next frame
+	if(vetoed)
+	  {
+	    ++m_cam.m_nb_vetoed_frames;
+	    return true;
+	  }
+      }
+      break;
+    case Camera::DEDICATED_POOL:
+      return m_decompress_pool->push(frame_info.acq_frame_nb);
+    default:
+      break;
+    }
+  return m_buffer_ctrl_obj->newFrameReady(frame_info);
+}
+
+/** decompress a frame into its Lima buffer outside processlib,
+ *  with the reconstruction task code
+ *  @param vetoed set if the spot finding vetoed the frame
+ *  @return false if the decompression failed, an error event is reported
+ */
+bool Stream::_decompress(int acq_frame_nb,bool& vetoed)
+{
+  DEB_MEMBER_FUNCT();
+  StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj->getBuffer();
+  FrameDim frame_dim;
+  m_buffer_ctrl_obj->getFrameDim(frame_dim);
+
+  Data frame;
+  switch(frame_dim.getImageType())
+    {
+    case Bpp16: frame.type = Data::UINT16;break;
+    case Bpp16S: frame.type = Data::INT16;break;
+    case Bpp32: frame.type = Data::UINT32;break;
+    case Bpp32S: frame.type = Data::INT32;break;
+    default:
+      DEB_ERROR() << "Image type not managed: " << DEB_VAR1(frame_dim);
+      return false;
+    }
+  frame.dimensions.push_back(frame_dim.getSize().getWidth());
+  frame.dimensions.push_back(frame_dim.getSize().getHeight());
+  frame.frameNumber = acq_frame_nb;
+  Buffer* buffer = new Buffer();
+  buffer->owner = Buffer::MAPPED;
+  buffer->data = buffer_mgr.getFrameBufferPtr(acq_frame_nb);
+  frame.setBuffer(buffer);
+  buffer->unref();
+
+  try
+    {
+      vetoed = m_decompress->getReconstructionTask()->process(frame).empty();
+    }
+  catch(ProcessException& e)
+    {
+      std::ostringstream error;
+      error << "Frame " << acq_frame_nb << ": " << e.getErrMsg();
+      DEB_ERROR() << error.str();
+      Event* event = new Event(Hardware,Event::Error,Event::Acquisition,
+			       Event::CamFault,error.str());
+      m_cam.reportEvent(event);
+      return false;
+    }
+  return true;
+}
+
+/** raw dump file of the current acquisition, if any
+ */
+std::shared_ptr<RawDump> Stream::get_raw_dump()
+{
+  AutoMutex lock(m_cam.m_raw_dump_mutex);
+  return m_cam.m_raw_dump;
+}
+
+FrameRing<int>* Stream::get_nb_peaks()
+{
+  return m_cam.m_nb_peaks;
+}
+
+/** occupancy threshold under which frames are sent sparse,
+ *  0 if disabled
+ */
+double Stream::get_sparse_threshold() const
+{
+  return m_sparse_threshold;
+}
+
+/** value of the saturated pixels of widened (16 to 32 bits) frames
+ */
+unsigned int Stream::get_saturated_value() const
+{
+  return m_saturated_value;
+}
+
+/** full frame size sent by the detector and the roi to extract
+ *  (not active if the full frame is used)
+ */
+void Stream::get_roi(Size& frame_size,Roi& roi) const
+{
+  frame_size = m_frame_size;
+  roi = m_roi;
+}
+
+void Stream::_read_pixel_mask(std::vector<std::shared_ptr<Stream::Message> >& pending_messages)
+{
+  DEB_MEMBER_FUNCT();
+
+  int nb_messages = pending_messages.size();
+  // look for the pixel mask header part, data follows it
+  for(int i = 2;i < nb_messages - 1;++i)
+    {
+      Json::Value header;
+      if(!_get_json_header(pending_messages[i],header)) continue;
+      std::string htype = header.get("htype","").asString();
+      if(htype.find("dpixelmask-") == std::string::npos) continue;
+
+      Json::Value shape = header.get("shape","");
+      if(!shape.isArray() || shape.size() != 2) break;
+      int nb_pixels = shape[0u].asInt() * shape[1u].asInt();
+      if(nb_pixels != m_frame_size.getWidth() * m_frame_size.getHeight())
+	{
+	  DEB_WARNING() << "Pixel mask ignored, its size doesn't match the frame "
+			<< DEB_VAR1(m_frame_size);
+	  break;
+	}
+      std::string dtype = header.get("type","none").asString();
+
+      zmq_msg_t* data_msg = pending_messages[i + 1]->get_msg();
+      void* data = zmq_msg_data(data_msg);
+      size_t data_size = zmq_msg_size(data_msg);
+
+      std::shared_ptr<Decompress::PixelMask> pixel_mask(new Decompress::PixelMask());
+      if(dtype == "uint32" && data_size >= nb_pixels * sizeof(uint32_t))
+	pixel_mask->build((const uint32_t*)data,nb_pixels);
+      else if(dtype == "uint16" && data_size >= nb_pixels * sizeof(uint16_t))
+	pixel_mask->build((const uint16_t*)data,nb_pixels);
+      else if(dtype == "uint8" && data_size >= size_t(nb_pixels))
+	pixel_mask->build((const uint8_t*)data,nb_pixels);
+      else
+	{
+	  DEB_WARNING() << "Pixel mask ignored: " << DEB_VAR2(dtype,data_size);
+	  break;
+	}
+      pixel_mask->buildMasked(m_frame_size,m_roi);
+      DEB_TRACE() << "Pixel mask: " << pixel_mask->getNbMaskedPixels() << " masked pixels in "
+		  << pixel_mask->m_runs.size() << " runs";
+
+      AutoMutex lock(m_pixel_mask_mutex);
+      m_pixel_mask = pixel_mask;
+      break;
+    }
+}
+
 void Stream::_run()
 {
   DEB_MEMBER_FUNCT();
@@ -356,10 +1224,19 @@ void Stream::_run()
 	  DEB_TRACE() << "Running";
 	}
       if(m_stop) break;
+      // the whole series, nb images per trigger x nb triggers
+      // in the multi trigger modes
       int nb_frames;
       m_cam.getNbFrames(nb_frames);
+      // with software summation, nb_summed_frames detector frames
+      // are received for each Lima frame
+      int nb_summed_frames;
+      m_cam.getSoftwareSummation(nb_summed_frames);
+      nb_frames *= nb_summed_frames;
       TrigMode trigger_mode;
       m_cam.getTrigMode(trigger_mode);
+      int nb_buffers;
+      buffer_mgr.getNbBuffers(nb_buffers);
 
       bool continue_flag = true;
       //open stream socket
@@ -416,19 +1293,18 @@ void Stream::_run()
 			{
 			  std::string htype = stream_header.get("htype","").asString();
 			  DEB_TRACE() << DEB_VAR1(htype);
-#ifdef READ_HEADER
 			  if(htype.find("dheader-") != std::string::npos)
 			    {
+#ifdef READ_HEADER
 			      Json::Value header;
 			      continue_flag = _get_header(stream_header,nb_messages,
 							  pending_messages,header);
-			      
-			    }
-			  else 
 #endif
-			    if(htype.find("dimage-") != std::string::npos)
+			      _read_pixel_mask(pending_messages);
+			    }
+			  else if(htype.find("dimage-") != std::string::npos)
 			    {
-			      int frameid = stream_header.get("frame",-1).asInt();
+			      int frameid = stream_header.get("frame",-1).asInt() - m_frame_offset;
 			      DEB_TRACE() << DEB_VAR1(frameid);
 			      //stream_header.get("hash","md5sum")
 			      if(nb_messages < 3)
@@ -460,10 +1336,42 @@ void Stream::_run()
 			      
 			      DEB_TRACE() << DEB_VAR1(anImageDim);
 			      HwFrameInfoType frame_info;
-			      frame_info.acq_frame_nb = frameid;
-			      void* buffer_ptr = buffer_mgr.getFrameBufferPtr(frameid);
+			      // the vetoed frames are not given to Lima
+			      frame_info.acq_frame_nb = frameid / nb_summed_frames -
+				m_cam.m_nb_vetoed_frames;
+			      int summed_frame_idx = frameid % nb_summed_frames;
+			      const char* overrun = NULL;
+			      if(m_decompression_placement == Camera::DEDICATED_POOL &&
+				 !summed_frame_idx &&
+				 !m_decompress_pool->check_overrun(frame_info.acq_frame_nb,
+								   nb_buffers))
+				overrun = "Decompression pool overrun";
+			      else if(!summed_frame_idx &&
+				      !m_buffer_ctrl_obj->isBufferFree(frame_info.acq_frame_nb))
+				overrun = "Compressed slots overrun";
+			      if(overrun)
+				{
+				  DEB_ERROR() << overrun << " at frame "
+					      << frame_info.acq_frame_nb;
+				  Event* event = new Event(Hardware,Event::Error,Event::Acquisition,
+							   Event::CamOverrun,overrun);
+				  m_cam.reportEvent(event);
+				  continue_flag = false;
+				  break;
+				}
+			      Timestamp start_timestamp;
+			      m_buffer_ctrl_obj->getStartTimestamp(start_timestamp);
+			      void* buffer_ptr = buffer_mgr.getFrameBufferPtr(frame_info.acq_frame_nb);
+			      Timestamp now = Timestamp::now();
+			      m_cam._frame_received(now);
 			      m_buffer_cbk->register_new_msg(pending_messages[2],buffer_ptr,
-							     anImageDim.getDepth());
+							     anImageDim.getDepth(),
+							     frame_info.acq_frame_nb,
+							     now - start_timestamp,
+							     !summed_frame_idx);
+			      m_cam._compressed_frame(frameid,
+						      zmq_msg_size(pending_messages[2]->get_msg()),
+						      anImageDim.getMemSize());
 #ifdef READ_HEADER
 			      if(nb_messages == 5)
 				{
@@ -472,7 +1380,8 @@ void Stream::_run()
 				  size_t header_size = zmq_msg_size(&msg);
 				}
 #endif
-			      continue_flag = buffer_mgr.newFrameReady(frame_info);
+			      if(summed_frame_idx == nb_summed_frames - 1)
+				continue_flag = _frame_ready(frame_info);
 			      if(trigger_mode != IntTrig && trigger_mode != IntTrigMult && !--nb_frames)
 				m_cam.disarm();
 			    }
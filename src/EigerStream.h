@@ -22,9 +22,14 @@
 #ifndef EIGERSTREAM_H
 #define EIGERSTREAM_H
 
+#include <memory>
+#include <atomic>
+#include <vector>
+
 #include "lima/Debug.h"
 
 #include "EigerCamera.h"
+#include "EigerDecompress.h"
 #include "lima/HwBufferMgr.h"
 
 namespace lima
@@ -50,22 +55,39 @@ namespace lima
       
       void setActive(bool);
       bool isActive() const;
+      void setDecompress(Decompress*);
 
       HwBufferCtrlObj* getBufferCtrlObj();
       bool get_msg(void* aDataBuffer,void*& msg_data,size_t& msg_size,
-		   int& depth);
+		   int& depth,int msg_index = 0);
+      std::shared_ptr<const Decompress::PixelMask> get_pixel_mask();
+      FrameRing<Camera::FrameStatistics>* get_statistics();
+      void get_roi(Size& frame_size,Roi& roi) const;
+      double get_sparse_threshold() const;
+      unsigned int get_saturated_value() const;
+      AzimuthalIntegrator* get_azimuthal_integrator();
+      SpotFinder* get_spot_finder();
+      Recompress* get_recompress();
+      std::shared_ptr<RawDump> get_raw_dump();
+      FrameRing<int>* get_nb_peaks();
     private:
       class _BufferCallback;
       class _BufferCtrlObj;
       friend class _BufferCtrlObj;
+      class _DecompressPool;
+      friend class _DecompressPool;
 
       static void* _runFunc(void*);
       void _run();
       void _send_synchro();
+      void _read_pixel_mask(std::vector<std::shared_ptr<Message> >&);
+      bool _frame_ready(HwFrameInfoType&);
+      bool _decompress(int acq_frame_nb,bool& vetoed);
       
       Camera&		m_cam;
       bool		m_active;
       HeaderDetail	m_header_detail;
+      HeaderDetail	m_sent_header_detail;
       bool		m_dirty_flag;
 
       mutable Cond	m_cond;
@@ -78,6 +100,21 @@ namespace lima
       int		m_pipes[2];
       _BufferCallback*	m_buffer_cbk;
       _BufferCtrlObj*	m_buffer_ctrl_obj;
+      Mutex		m_pixel_mask_mutex;
+      bool		m_apply_pixel_mask;
+      std::shared_ptr<const Decompress::PixelMask> m_pixel_mask;
+      bool		m_statistics_active;
+      double		m_sparse_threshold;
+      bool		m_azimuthal_integration_active;
+      bool		m_spot_finding_active;
+      Size		m_frame_size;
+      Roi		m_roi;
+      unsigned int	m_saturated_value;
+      bool		m_recompression_active;
+      Decompress*	m_decompress;
+      Camera::DecompressionPlacement m_decompression_placement;
+      _DecompressPool*	m_decompress_pool;
+      std::atomic<int>	m_frame_offset;
     };
   }
 }
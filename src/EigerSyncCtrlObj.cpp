@@ -124,6 +124,24 @@ void SyncCtrlObj::getNbHwFrames(int& nb_frames)
     m_cam.getNbFrames(nb_frames);
 }
 
+//-----------------------------------------------------
+// @brief images of each trigger in the multi trigger modes
+//-----------------------------------------------------
+void SyncCtrlObj::setNbImagesPerTrigger(int nb_images)
+{
+    DEB_MEMBER_FUNCT();
+    m_cam.setNbImagesPerTrigger(nb_images);
+}
+
+//-----------------------------------------------------
+// @brief
+//-----------------------------------------------------
+void SyncCtrlObj::getNbImagesPerTrigger(int& nb_images)
+{
+    DEB_MEMBER_FUNCT();    
+    m_cam.getNbImagesPerTrigger(nb_images);
+}
+
 //--- @brief--------------------------------------------------
 //
 //-----------------------------------------------------